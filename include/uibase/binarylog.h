@@ -0,0 +1,256 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <QString>
+
+#include "dllimport.h"
+#include "log.h"
+
+// binary logging with deferred formatting
+//
+// a BinaryLogger does not format messages on the logging thread, it records
+// the address of the format string, a timestamp, the thread id and the raw
+// bytes of the arguments in a ring buffer owned by the thread; a background
+// thread drains the buffers and either writes the records to a file, decoded
+// later by decodeBinaryLog() (see the uibase-logdecode tool), or formats them
+// and forwards them to a regular Logger
+//
+// only format strings known at compile time are supported, and arguments that
+// are not strings, QStrings, numbers, bools, chars or void pointers are
+// formatted on the logging thread with the specification of their replacement
+// field; nested replacement fields (dynamic width or precision) are not
+// supported
+
+namespace MOBase::log::details
+{
+
+// maximum number of arguments of a binary log message
+//
+constexpr std::size_t MaxBinaryArgs = 16;
+
+enum class BinaryArg : std::uint8_t
+{
+  Int = 1,
+  UInt,
+  Double,
+  Bool,
+  Char,
+  String,
+  QString,
+  Pointer,
+  Float,
+
+  // string formatted on the logging thread, the specification of the
+  // replacement field has already been applied
+  Formatted
+};
+
+// per-thread buffer used to encode the arguments of a message
+//
+QDLLEXPORT std::vector<std::byte>& binaryScratch() noexcept;
+
+// returns the format specification of the replacement field used by the
+// argument at the given index, without the colon; empty if there is none or
+// if it contains a nested replacement field
+//
+QDLLEXPORT std::string_view binaryArgSpec(std::string_view format,
+                                          std::size_t index) noexcept;
+
+inline void writeBinary(std::vector<std::byte>& out, const void* data, std::size_t n)
+{
+  const auto* bytes = static_cast<const std::byte*>(data);
+  out.insert(out.end(), bytes, bytes + n);
+}
+
+template <class T>
+void writeBinaryValue(std::vector<std::byte>& out, BinaryArg type, T value)
+{
+  out.push_back(static_cast<std::byte>(type));
+  writeBinary(out, &value, sizeof(value));
+}
+
+inline void writeBinaryString(std::vector<std::byte>& out, BinaryArg type,
+                              const void* data, std::size_t size, std::size_t n)
+{
+  out.push_back(static_cast<std::byte>(type));
+
+  const auto length = static_cast<std::uint32_t>(n);
+  writeBinary(out, &length, sizeof(length));
+  writeBinary(out, data, n * size);
+}
+
+// encodes the argument at the given index of a message; `format` is only used
+// for arguments that are formatted now
+//
+template <class T>
+void writeBinaryArg(std::vector<std::byte>& out, std::string_view format,
+                    std::size_t index, const T& value)
+{
+  using U = std::remove_cvref_t<T>;
+
+  if constexpr (std::is_same_v<U, bool>) {
+    writeBinaryValue(out, BinaryArg::Bool, static_cast<std::uint8_t>(value));
+  } else if constexpr (std::is_same_v<U, char>) {
+    writeBinaryValue(out, BinaryArg::Char, value);
+  } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+    writeBinaryValue(out, BinaryArg::Int, static_cast<std::int64_t>(value));
+  } else if constexpr (std::is_integral_v<U>) {
+    writeBinaryValue(out, BinaryArg::UInt, static_cast<std::uint64_t>(value));
+  } else if constexpr (std::is_same_v<U, float>) {
+    // kept as a float, or the shortest representation would be the one of the
+    // double
+    writeBinaryValue(out, BinaryArg::Float, value);
+  } else if constexpr (std::is_floating_point_v<U>) {
+    writeBinaryValue(out, BinaryArg::Double, static_cast<double>(value));
+  } else if constexpr (std::is_same_v<U, QString>) {
+    writeBinaryString(out, BinaryArg::QString, value.utf16(), sizeof(char16_t),
+                      static_cast<std::size_t>(value.size()));
+  } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+    const std::string_view sv(value);
+    writeBinaryString(out, BinaryArg::String, sv.data(), 1, sv.size());
+  } else if constexpr (std::is_same_v<U, std::nullptr_t> ||
+                       std::is_same_v<U, void*> || std::is_same_v<U, const void*>) {
+    writeBinaryValue(out, BinaryArg::Pointer,
+                     reinterpret_cast<std::uintptr_t>(static_cast<const void*>(value)));
+  } else {
+    // anything else is formatted now, the type is not known when decoding
+    const auto spec = binaryArgSpec(format, index);
+
+    const auto s = spec.empty() ? std::format("{}", value)
+                                : std::vformat(std::string("{:").append(spec) + "}",
+                                               std::make_format_args(value));
+
+    writeBinaryString(out, BinaryArg::Formatted, s.data(), 1, s.size());
+  }
+}
+
+}  // namespace MOBase::log::details
+
+namespace MOBase::log
+{
+
+struct BinaryLoggerConfiguration
+{
+  // file to write the records to, nothing is written if empty
+  std::filesystem::path file;
+
+  // logger to forward the formatted messages to, if any; it must outlive the
+  // binary logger and its own level and blacklist still apply
+  Logger* target = nullptr;
+
+  Levels maxLevel = Levels::Debug;
+
+  // size of the ring buffer of each thread, in bytes; messages that do not fit
+  // are dropped and counted
+  std::size_t bufferSize = 1 << 20;
+
+  // how often the background thread drains the buffers
+  std::chrono::milliseconds interval{50};
+};
+
+class QDLLEXPORT BinaryLogger
+{
+public:
+  BinaryLogger(BinaryLoggerConfiguration conf);
+  ~BinaryLogger();
+
+  BinaryLogger(const BinaryLogger&)            = delete;
+  BinaryLogger& operator=(const BinaryLogger&) = delete;
+
+  Levels level() const;
+  void setLevel(Levels lv);
+
+  bool enabled(Levels lv) const noexcept
+  {
+    return lv >= m_level.load(std::memory_order_relaxed);
+  }
+
+  // drains the buffers of all the threads now, writing or forwarding
+  // everything that has been logged before this call
+  //
+  void flush();
+
+  // number of messages dropped because a ring buffer was full
+  //
+  std::uint64_t dropped() const;
+
+  template <class... Args>
+  void debug(std::format_string<Args...> format, Args&&... args) noexcept
+  {
+    log(Debug, format, std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  void info(std::format_string<Args...> format, Args&&... args) noexcept
+  {
+    log(Info, format, std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  void warn(std::format_string<Args...> format, Args&&... args) noexcept
+  {
+    log(Warning, format, std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  void error(std::format_string<Args...> format, Args&&... args) noexcept
+  {
+    log(Error, format, std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  void log(Levels lv, std::format_string<Args...> format, Args&&... args) noexcept
+  {
+    static_assert(sizeof...(Args) <= details::MaxBinaryArgs,
+                  "too many arguments for a binary log message");
+
+    if (!enabled(lv)) {
+      return;
+    }
+
+    try {
+      auto& scratch = details::binaryScratch();
+      scratch.clear();
+
+      [[maybe_unused]] std::size_t index = 0;
+      (details::writeBinaryArg(scratch, format.get(), index++, args), ...);
+
+      submit(lv, format.get(), sizeof...(Args), scratch);
+    } catch (...) {
+      // eat it
+    }
+  }
+
+private:
+  class Impl;
+
+  std::atomic<Levels> m_level;
+  std::unique_ptr<Impl> m_impl;
+
+  void submit(Levels lv, std::string_view format, std::size_t argCount,
+              const std::vector<std::byte>& args) noexcept;
+};
+
+// decodes a file written by a BinaryLogger, calling the given callback for each
+// message in file order (messages of different threads are only ordered by
+// drain cycle, use the time of the entries to sort them); the formatted message
+// of the entries contains the time, thread and level
+//
+// returns false if the file cannot be opened or is not a binary log, a
+// truncated file is decoded up to the last complete message
+//
+QDLLEXPORT bool decodeBinaryLog(const std::filesystem::path& file,
+                                const std::function<void(Entry)>& callback);
+
+}  // namespace MOBase::log
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "dllimport.h"
+#include "log.h"
+
+// flight recorder
+//
+// a FlightRecorder keeps the last messages logged by each thread in memory,
+// including the levels the logger does not write, so that the context of an
+// error can be written along with it; see Logger::setFlightRecorder()
+//
+// each thread records into its own ring buffer of fixed-size slots without
+// locking, the oldest message is overwritten when the ring is full and
+// messages longer than a slot are truncated
+
+namespace MOBase::log
+{
+
+class QDLLEXPORT FlightRecorder
+{
+public:
+  FlightRecorder(FlightRecorderConfiguration conf);
+  ~FlightRecorder();
+
+  FlightRecorder(const FlightRecorder&)            = delete;
+  FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+  const FlightRecorderConfiguration& configuration() const;
+
+  // whether messages of the given level are recorded, errors never are
+  //
+  bool records(Levels lv) const noexcept;
+
+  // records a message in the ring buffer of the calling thread
+  //
+  void record(Levels lv, std::string_view message) noexcept;
+
+  // returns the messages recorded by all the threads since the last call,
+  // ordered by time; messages that are overwritten while this runs are lost
+  //
+  // the formatted message of the entries contains the time, thread and level
+  //
+  std::vector<Entry> take();
+
+private:
+  class Impl;
+
+  FlightRecorderConfiguration m_conf;
+  std::unique_ptr<Impl> m_impl;
+};
+
+}  // namespace MOBase::log
@@ -47,7 +47,7 @@ struct std::formatter<QByteArray, CharT>
     : std::formatter<std::basic_string<CharT>, CharT>
 {
   template <class FmtContext>
-  FmtContext::iterator format(QByteArray v, FmtContext& ctx) const
+  FmtContext::iterator format(const QByteArray& v, FmtContext& ctx) const
   {
     return std::format_to(ctx.out(), "QByteArray({} bytes)", v.size());
   }
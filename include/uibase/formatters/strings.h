@@ -1,10 +1,14 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
 #include <format>
 #include <string>
 #include <string_view>
+#include <type_traits>
 
+#include <QChar>
 #include <QString>
 #include <QStringView>
 
@@ -50,18 +54,70 @@ inline QString fromStdBasicString(std::u32string const& value)
 {
   return QString::fromStdU32String(value);
 }
-}  // namespace MOBase::details
 
-template <class CharT>
-struct std::formatter<QString, CharT> : std::formatter<std::basic_string<CharT>, CharT>
+// transcodes the given UTF-16 string to UTF-8 by chunks, calling sink(data, size)
+// for each of them; unpaired surrogates are replaced by U+FFFD
+//
+template <class Sink>
+void transcodeUtf8(QStringView s, Sink&& sink)
 {
-  template <class FmtContext>
-  FmtContext::iterator format(QString s, FmtContext& ctx) const
-  {
-    return std::formatter<std::basic_string<CharT>, CharT>::format(
-        MOBase::details::toStdBasicString<CharT>(s), ctx);
+  constexpr std::size_t ChunkSize = 256;
+
+  const char16_t* p = s.utf16();
+  const auto n      = static_cast<std::size_t>(s.size());
+
+  // at most 3 bytes per UTF-16 unit, pairs take 4 bytes for 2 units
+  char buffer[3 * ChunkSize];
+
+  for (std::size_t i = 0; i < n;) {
+    auto end = std::min(n, i + ChunkSize);
+
+    // keep surrogate pairs in the same chunk
+    if (end < n && QChar::isHighSurrogate(p[end - 1])) {
+      --end;
+    }
+
+    std::size_t length = 0;
+
+    while (i < end) {
+      // runs of ASCII are copied as-is
+      while (i < end && p[i] < 0x80) {
+        buffer[length++] = static_cast<char>(p[i++]);
+      }
+
+      if (i == end) {
+        break;
+      }
+
+      char32_t c = p[i++];
+
+      if (QChar::isSurrogate(c)) {
+        if (QChar::isHighSurrogate(c) && i < end && QChar::isLowSurrogate(p[i])) {
+          c = QChar::surrogateToUcs4(static_cast<char16_t>(c), p[i++]);
+        } else {
+          c = QChar::ReplacementCharacter;
+        }
+      }
+
+      if (c < 0x800) {
+        buffer[length++] = static_cast<char>(0xc0 | (c >> 6));
+      } else if (c < 0x10000) {
+        buffer[length++] = static_cast<char>(0xe0 | (c >> 12));
+        buffer[length++] = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+      } else {
+        buffer[length++] = static_cast<char>(0xf0 | (c >> 18));
+        buffer[length++] = static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+        buffer[length++] = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+      }
+
+      buffer[length++] = static_cast<char>(0x80 | (c & 0x3f));
+    }
+
+    sink(static_cast<const char*>(buffer), length);
   }
-};
+}
+
+}  // namespace MOBase::details
 
 template <class CharT1, class CharT2>
   requires(!std::is_same_v<CharT1, CharT2>)
@@ -78,12 +134,83 @@ struct std::formatter<std::basic_string<CharT1>, CharT2>
   }
 };
 
+// QStringView and QString are not converted to a temporary std::string: they are
+// transcoded straight to the output for char, viewed as-is for wchar_t and char16_t,
+// and only go through a buffer when the specification has a width or a precision
+//
 template <class CharT>
-struct std::formatter<QStringView, CharT> : std::formatter<QString, CharT>
+struct std::formatter<QStringView, CharT>
+    : std::formatter<std::basic_string_view<CharT>, CharT>
 {
+  using base = std::formatter<std::basic_string_view<CharT>, CharT>;
+
+  constexpr auto parse(std::basic_format_parse_context<CharT>& ctx)
+  {
+    m_plain = ctx.begin() == ctx.end() || *ctx.begin() == '}';
+    return base::parse(ctx);
+  }
+
+  constexpr void set_debug_format()
+  {
+    m_plain = false;
+    base::set_debug_format();
+  }
+
   template <class FmtContext>
   FmtContext::iterator format(QStringView s, FmtContext& ctx) const
   {
-    return std::formatter<QString, CharT>::format(s.toString(), ctx);
+    if constexpr (sizeof(CharT) == sizeof(char16_t)) {
+      return base::format(
+          std::basic_string_view<CharT>(reinterpret_cast<const CharT*>(s.utf16()),
+                                        static_cast<std::size_t>(s.size())),
+          ctx);
+    } else if constexpr (std::is_same_v<CharT, char>) {
+      if (m_plain) {
+        auto out = ctx.out();
+        MOBase::details::transcodeUtf8(s, [&out](const char* data, std::size_t n) {
+          out = std::copy_n(data, n, out);
+        });
+        return out;
+      }
+
+      // the standard formatter handles the specification, short strings are
+      // transcoded on the stack
+      constexpr std::size_t SmallSize = 128;
+      if (static_cast<std::size_t>(s.size()) <= SmallSize) {
+        char buffer[3 * SmallSize];
+        std::size_t length = 0;
+
+        MOBase::details::transcodeUtf8(s, [&](const char* data, std::size_t n) {
+          std::copy_n(data, n, buffer + length);
+          length += n;
+        });
+
+        return base::format(std::string_view(buffer, length), ctx);
+      }
+
+      std::string buffer;
+      buffer.reserve(static_cast<std::size_t>(s.size()));
+
+      MOBase::details::transcodeUtf8(s, [&buffer](const char* data, std::size_t n) {
+        buffer.append(data, n);
+      });
+
+      return base::format(buffer, ctx);
+    } else {
+      return base::format(MOBase::details::toStdBasicString<CharT>(s.toString()), ctx);
+    }
+  }
+
+private:
+  bool m_plain = true;
+};
+
+template <class CharT>
+struct std::formatter<QString, CharT> : std::formatter<QStringView, CharT>
+{
+  template <class FmtContext>
+  FmtContext::iterator format(const QString& s, FmtContext& ctx) const
+  {
+    return std::formatter<QStringView, CharT>::format(QStringView(s), ctx);
   }
 };
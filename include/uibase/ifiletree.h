@@ -27,7 +27,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <map>
 #include <memory>
 #include <mutex>
+#include <span>
 #include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <version>
 
@@ -35,6 +38,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <QFlags>
 #include <QList>
 #include <QString>
+#include <QStringView>
 
 #include "dllimport.h"
 #include "utility.h"
@@ -70,6 +74,7 @@ namespace MOBase
  *
  */
 class IFileTree;
+class TreeEditBatch;
 
 /**
  * @brief Simple valid C++ comparator for QString that compare them case-insensitive,
@@ -104,6 +109,39 @@ struct FileNameComparator
   }
 };
 
+/**
+ * @brief Hash for filenames consistent with FileNameComparator, i.e., two names that
+ *     compare equal have the same hash.
+ *
+ * Names made only of ASCII characters are folded while being hashed, other names are
+ * case-folded once before being hashed. Interned names (see internString()) are not
+ * hashed again, the pool keeps their hash. This is transparent so containers can be
+ * searched with a QStringView without creating a QString.
+ */
+struct QDLLEXPORT FileNameHash
+{
+  using is_transparent = void;
+
+  std::size_t operator()(QStringView name) const;
+};
+
+/**
+ * @brief Equality for filenames consistent with FileNameComparator.
+ */
+struct QDLLEXPORT FileNameEqual
+{
+  using is_transparent = void;
+
+  bool operator()(QStringView lhs, QStringView rhs) const;
+};
+
+/**
+ * @brief Unordered containers keyed case-insensitively by filename.
+ */
+template <class T>
+using FileNameMap = std::unordered_map<QString, T, FileNameHash, FileNameEqual>;
+using FileNameSet = std::unordered_set<QString, FileNameHash, FileNameEqual>;
+
 /**
  * @brief Exception thrown when an operation on the tree is not supported by the
  *     implementation or makes no sense (e.g., creation of a file in an archive).
@@ -202,7 +240,15 @@ public:  // Methods
    *
    * @return -1, 0 or 1 depending on the result of the comparison.
    */
-  int compare(QString name) const { return FileNameComparator::compare(m_Name, name); }
+  int compare(QString name) const
+  {
+    // names are interned, so equal names usually share their data
+    if (m_Name.constData() == name.constData() && m_Name.size() == name.size()) {
+      return 0;
+    }
+
+    return FileNameComparator::compare(m_Name, name);
+  }
 
   /**
    * @brief Retrieve the "last" extension of this entry.
@@ -327,9 +373,11 @@ protected:  // Constructors:
 private:
   std::weak_ptr<const IFileTree> m_Parent;
 
+  // interned, see internString()
   QString m_Name;
 
   friend class IFileTree;
+  friend class TreeEditBatch;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(FileTreeEntry::FileTypes);
@@ -395,6 +443,34 @@ public:  // Enumerations and aliases:
   using OverwritesType = std::map<std::shared_ptr<const FileTreeEntry>,
                                   std::shared_ptr<const FileTreeEntry>>;
 
+  /**
+   * @brief Number of entries removed by pruneRecursive().
+   */
+  struct PruneCounts
+  {
+    std::size_t files       = 0;
+    std::size_t directories = 0;
+  };
+
+  /**
+   * @brief Estimated memory used by a tree, see memoryUsage().
+   */
+  struct MemoryUsage
+  {
+    // number of file and directory entries, not counting the tree itself
+    std::size_t files       = 0;
+    std::size_t directories = 0;
+
+    // bytes used by the entry objects, their names, the vectors of children and the
+    // shared pointer control blocks
+    std::size_t nodes         = 0;
+    std::size_t names         = 0;
+    std::size_t children      = 0;
+    std::size_t controlBlocks = 0;
+
+    std::size_t total() const { return nodes + names + children + controlBlocks; }
+  };
+
 public:  // Iterators:
   /**
    * The standard iterator are constant, but the pointed value are not. Since
@@ -651,6 +727,19 @@ public:  // Utility functions:
    */
   std::shared_ptr<IFileTree> createOrphanTree(QString name = "") const;
 
+  /**
+   * @brief Estimate the memory used by this tree and all its subtrees.
+   *
+   * The tree is walked once, without populating subtrees that have not been populated
+   * yet. The result is an estimate: entries are counted with the size of the base
+   * classes (not the actual classes created by makeFile() and makeDirectory()),
+   * allocator overhead is ignored and names are interned (see internString()) so each
+   * distinct name is counted once.
+   *
+   * @return the memory used by this tree, including this tree itself.
+   */
+  MemoryUsage memoryUsage() const;
+
 public:  // Mutable operations:
   /**
    * @brief Create a new file directly under this tree.
@@ -853,6 +942,41 @@ public:  // Mutable operations:
   std::size_t
   removeIf(std::function<bool(std::shared_ptr<FileTreeEntry> const& entry)> predicate);
 
+  /**
+   * @brief Delete the given entries from the tree.
+   *
+   * Calling erase() for each entry moves the following entries of the tree for every
+   * deleted entry, this method removes all the entries with a single pass over the
+   * tree. Entries that are not directly in this tree, or for which beforeRemove()
+   * returns false, are kept. This method invalidates iterators.
+   *
+   * @param entries Entries to delete.
+   *
+   * @return the number of deleted entry.
+   */
+  std::size_t removeEntries(std::span<const std::shared_ptr<FileTreeEntry>> entries);
+
+  /**
+   * @brief Delete the entries that match the given predicate from this tree and all
+   * its subtrees.
+   *
+   * The tree is traversed once, bottom-up, with a single erase pass per directory.
+   * Directories matching the predicate are removed with their content without being
+   * traversed (and thus without being populated). The predicate is called before
+   * beforeRemove(), and entries for which beforeRemove() returns false are kept. This
+   * method invalidates iterators.
+   *
+   * @param predicate Predicate that should return true for entries to delete.
+   * @param pruneEmptyDirs If true, directories that are empty after pruning their
+   *     content (or that were already empty) are also deleted.
+   *
+   * @return the number of files and directories deleted, not counting the content
+   *     of deleted directories.
+   */
+  PruneCounts pruneRecursive(
+      std::function<bool(std::shared_ptr<FileTreeEntry> const& entry)> predicate,
+      bool pruneEmptyDirs = false);
+
 public:  // Inherited methods:
   /**
    * @brief Retrieve the tree corresponding to this entry. Returns a null pointer
@@ -916,6 +1040,7 @@ public:  // Deleted operators:
    */
 protected:
   friend class FileTreeEntry;
+  friend class TreeEditBatch;
 
   /**
    * Split the given path into parts.
@@ -1021,7 +1146,8 @@ protected:
    * If the implementation can populate the vector of entries in order, it is possible
    * to return false to tell IFileTree not to re-sort the vector. If sorted, directories
    * should be before files, and both directories and files should be sorted by name in
-   * a case-insensitive way.
+   * a case-insensitive way (see FileNameComparator). Entries are looked up by binary
+   * search, so a vector returned as sorted is checked and sorted anyway if it is not.
    *
    * @param parent The current tree, without const-qualification.
    * @param entries Vector of entries to populate.
@@ -1098,6 +1224,32 @@ private:  // Private stuff, look away!
   std::shared_ptr<IFileTree> createTree(QStringList::const_iterator begin,
                                         QStringList::const_iterator end);
 
+  /**
+   * @brief Rename the given entry, keeping the entries of its parent sorted.
+   *
+   * @param entry The entry to rename.
+   * @param name The new name of the entry.
+   */
+  static void renameEntry(std::shared_ptr<FileTreeEntry> const& entry, QString name);
+
+  /**
+   * @brief Detach the given entries from this tree with a single pass, without calling
+   * beforeRemove(). Entries that are not in this tree are ignored.
+   *
+   * @param detached Entries to detach.
+   *
+   * @return the number of detached entries.
+   */
+  std::size_t detachAll(std::unordered_set<const FileTreeEntry*> const& detached);
+
+  /**
+   * @brief Implementation of pruneRecursive() for this tree, accumulating the number
+   * of deleted entries in the given counts.
+   */
+  void pruneRecursive(
+      std::function<bool(std::shared_ptr<FileTreeEntry> const& entry)> const& predicate,
+      bool pruneEmptyDirs, PruneCounts& counts);
+
   // Indicate if this tree has been populated:
   mutable std::atomic<bool> m_Populated{false};
   mutable std::once_flag m_OnceFlag;
@@ -1117,6 +1269,111 @@ private:  // Private stuff, look away!
   void populate() const;
 };
 
+/**
+ * @brief A batch of moves, renames and removals on a file tree that are validated
+ *     together and applied at once.
+ *
+ * Performing many operations through IFileTree::move() splits the path, looks up or
+ * creates the intermediate trees and re-inserts in a sorted vector for every single
+ * call, and a failure in the middle leaves the tree half-modified. A batch records
+ * the operations first, and apply() then:
+ *   - validates all the operations (entries under the root, no entry modified twice,
+ *     no conflict between operations or with existing entries, no directory moved
+ *     into itself),
+ *   - creates the missing destination directories and calls the beforeX() hooks,
+ *     except for entries renamed in their own directory, like IFileTree::move(),
+ *   - detaches and inserts all the entries, sorting each affected directory once.
+ *
+ * If anything fails, directories created by the batch are removed and the tree is
+ * left untouched. Hooks that were already called and returned true are not notified
+ * of the rollback.
+ *
+ * Destination paths are relative to the root of the batch and are resolved against
+ * the tree as it is before the batch is applied. Operations never replace or merge
+ * existing entries, which is equivalent to InsertPolicy::FAIL_IF_EXISTS.
+ */
+class QDLLEXPORT TreeEditBatch
+{
+public:
+  /**
+   * @brief Create a new empty batch for the given tree.
+   *
+   * @param root The tree to modify. All the entries and paths given to the batch must
+   *     be under this tree.
+   */
+  explicit TreeEditBatch(std::shared_ptr<IFileTree> root);
+
+  /**
+   * @brief Record a move of the given entry to the given path.
+   *
+   * @param entry Entry to move.
+   * @param path The path to move the entry to. If the path ends with / or \, the
+   *     entry is moved in the corresponding directory, keeping its name. If the path
+   *     is empty, the entry is moved directly under the root.
+   */
+  void move(std::shared_ptr<FileTreeEntry> entry, QString path);
+
+  /**
+   * @brief Record a rename of the given entry, keeping it in its current directory.
+   *
+   * @param entry Entry to rename.
+   * @param name New name of the entry (must not contain separators).
+   */
+  void rename(std::shared_ptr<FileTreeEntry> entry, QString name);
+
+  /**
+   * @brief Record the removal of the given entry.
+   *
+   * @param entry Entry to remove.
+   */
+  void remove(std::shared_ptr<FileTreeEntry> entry);
+
+  /**
+   * @return the number of recorded operations.
+   */
+  std::size_t size() const { return m_Operations.size(); }
+
+  /**
+   * @return true if no operation has been recorded.
+   */
+  bool empty() const { return m_Operations.empty(); }
+
+  /**
+   * @brief Discard all the recorded operations.
+   */
+  void clear() { m_Operations.clear(); }
+
+  /**
+   * @brief Validate and apply all the recorded operations.
+   *
+   * The batch is cleared after this call, whether it succeeded or not.
+   *
+   * @return true if all the operations were applied, false if none were.
+   */
+  bool apply();
+
+private:
+  struct Operation
+  {
+    enum class Type
+    {
+      Move,
+      Rename,
+      Remove
+    };
+
+    Type type;
+    std::shared_ptr<FileTreeEntry> entry;
+
+    // destination directory (for Move) and new name (for Move and Rename)
+    QStringList directory;
+    QString name;
+  };
+
+  std::shared_ptr<IFileTree> m_Root;
+  std::vector<Operation> m_Operations;
+};
+
 }  // namespace MOBase
 
 // __has_cpp_attribute(__cpp_lib_generator) does not seem to work, maybe some conflict
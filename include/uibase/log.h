@@ -8,8 +8,16 @@
 #include <QSize>
 #include <QString>
 #include <QStringView>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <memory>
+#include <optional>
+#include <source_location>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <format>
@@ -38,6 +46,21 @@ enum Levels
   Error   = 3
 };
 
+// lowest level compiled in, set by the UIBASE_LOG_MIN_LEVEL CMake option;
+// messages below it are removed at compile time by Logger, Category and the
+// MO_LOG_* macros
+//
+#ifndef UIBASE_LOG_MIN_LEVEL
+#define UIBASE_LOG_MIN_LEVEL 0
+#endif
+
+constexpr Levels MinimumLevel = static_cast<Levels>(UIBASE_LOG_MIN_LEVEL);
+
+constexpr bool compiledIn(Levels lv)
+{
+  return lv >= MinimumLevel;
+}
+
 struct BlacklistEntry
 {
   std::string filter;
@@ -61,23 +84,27 @@ concept RuntimeFormatString = requires(F&& f, Args&&... args) {
   !std::is_convertible_v<std::decay_t<F>, std::string_view>;
 };
 
+// only called by the inline functions of plugins built against older versions
+// of this header, which format the messages of all the levels; the message goes
+// through the Logger owning the given spdlog logger, which checks the level
+//
 void QDLLEXPORT doLogImpl(spdlog::logger& lg, Levels lv, const std::string& s) noexcept;
 
+// state of a Logger added after its original members, see Logger::m_impl
+//
+class LoggerImpl;
+
+// formats a message; format errors return a short message without much
+// information to avoid throwing again and change the level to Error
+//
 template <class... Args>
-void doLog(spdlog::logger& logger, Levels lv,
-           const std::vector<MOBase::log::BlacklistEntry> bl,
-           std::format_string<Args...> format, Args&&... args) noexcept
+std::string formatMessage(Levels& lv, std::format_string<Args...> format,
+                          Args&&... args) noexcept
 {
-  // format errors are logged without much information to avoid throwing again
-
   std::string s;
+
   try {
     s = std::format(format, std::forward<Args>(args)...);
-
-    // check the blacklist
-    for (const BlacklistEntry& entry : bl) {
-      ireplace_all(s, entry.filter, entry.replacement);
-    }
   } catch (std::format_error&) {
     s  = "format error while logging";
     lv = Levels::Error;
@@ -89,18 +116,14 @@ void doLog(spdlog::logger& logger, Levels lv,
     lv = Levels::Error;
   }
 
-  doLogImpl(logger, lv, s);
+  return s;
 }
 
 template <class F, class... Args>
-void doLog(spdlog::logger& logger, Levels lv,
-           const std::vector<MOBase::log::BlacklistEntry> bl, F&& format,
-           Args&&... args) noexcept
+std::string formatMessage(Levels& lv, F&& format, Args&&... args) noexcept
 {
   std::string s;
 
-  // format errors are logged without much information to avoid throwing again
-
   try {
     if constexpr (sizeof...(Args) == 0) {
       s = std::format("{}", std::forward<F>(format));
@@ -109,11 +132,6 @@ void doLog(spdlog::logger& logger, Levels lv,
     } else {
       s = std::vformat(std::forward<F>(format), std::make_format_args(args...));
     }
-
-    // check the blacklist
-    for (const BlacklistEntry& entry : bl) {
-      ireplace_all(s, entry.filter, entry.replacement);
-    }
   } catch (std::format_error&) {
     s  = "format error while logging";
     lv = Levels::Error;
@@ -125,7 +143,7 @@ void doLog(spdlog::logger& logger, Levels lv,
     lv = Levels::Error;
   }
 
-  doLogImpl(logger, lv, s);
+  return s;
 }
 
 }  // namespace MOBase::log::details
@@ -169,6 +187,53 @@ struct Entry
 
 using Callback = void(Entry);
 
+// same as Entry, but the strings are only valid for the duration of the
+// callback
+//
+struct EntryView
+{
+  std::chrono::system_clock::time_point time;
+  Levels level;
+  std::string_view message;
+  std::string_view formattedMessage;
+};
+
+using ViewCallback  = void(const EntryView&);
+using BatchCallback = void(std::span<const EntryView>);
+
+class FlightRecorder;
+
+struct FlightRecorderConfiguration
+{
+  // number of messages kept for each thread, 0 disables the recorder
+  std::size_t capacity = 0;
+
+  // longer messages are truncated
+  std::size_t messageSize = 256;
+
+  // lowest level recorded, errors are never recorded
+  Levels level = Levels::Debug;
+
+  // whether logging an error dumps the recorded messages before it
+  bool dumpOnError = true;
+
+  // file the recorded messages are appended to when dumped; if empty, they are
+  // written to the sinks of the logger and only the messages the logger does
+  // not write are recorded
+  std::filesystem::path file;
+};
+
+// what an asynchronous logger does when its queue is full
+//
+enum class OverflowPolicy
+{
+  // the logging thread waits until there is room in the queue
+  Block,
+
+  // the oldest message in the queue is dropped
+  DropOldest
+};
+
 struct LoggerConfiguration
 {
   std::string name;
@@ -178,19 +243,109 @@ struct LoggerConfiguration
   std::vector<BlacklistEntry> blacklist;
 };
 
+// settings of a Logger that are not in LoggerConfiguration, which keeps its
+// original layout since plugins pass it by value to createDefault()
+//
+struct LoggerOptions
+{
+  // if true, messages are queued and written to the sinks by background
+  // threads instead of the logging thread; more than one thread may reorder
+  // messages
+  bool async              = false;
+  std::size_t queueSize   = 8192;
+  std::size_t threads     = 1;
+  OverflowPolicy overflow = OverflowPolicy::Block;
+
+  // sinks are flushed after each message at or above this level, and every
+  // flushInterval if it is not zero; they are always flushed when the logger
+  // is destroyed
+  Levels flushLevel                       = Levels::Debug;
+  std::chrono::milliseconds flushInterval = {};
+
+  // see Logger::setFlightRecorder()
+  FlightRecorderConfiguration flightRecorder;
+
+  // at most rateLimit messages are logged from each call site, identified by
+  // its format string, or its location for log::lazy(), per rateInterval; the
+  // number of dropped messages is logged when the call site is used again
+  // after the interval or when the logger is flushed
+  //
+  // 0 disables it, messages with a format string only known at runtime are
+  // never limited
+  std::size_t rateLimit                  = 0;
+  std::chrono::milliseconds rateInterval = std::chrono::seconds(1);
+
+  // consecutive identical messages are only logged once, followed by "last
+  // message repeated N times" when another message is logged or the logger is
+  // flushed; with several threads, only messages that reach the logger one
+  // after the other are coalesced
+  bool coalesceDuplicates = false;
+};
+
 class QDLLEXPORT Logger
 {
 public:
   Logger(LoggerConfiguration conf);
+  Logger(LoggerConfiguration conf, LoggerOptions options);
   ~Logger();
 
   Levels level() const;
   void setLevel(Levels lv);
 
+  // whether messages of the given level are logged; this is checked before
+  // formatting, so disabled levels only cost a call and a relaxed atomic load
+  // unless the flight recorder needs them
+  //
+  bool enabled(Levels lv) const noexcept;
+
+  // writes all the queued messages, if any, and flushes the sinks; in async
+  // mode, this waits until the background threads have written the messages
+  // logged before the call, for at most a few seconds; can be called from
+  // crash handlers
+  //
+  void flush();
+
   void setPattern(const std::string& pattern);
   void setFile(const File& f);
+
+  // same as setFile(), but files rotated out are compressed to gzip by a low
+  // priority background thread; like the uncompressed ones, at most maxFiles
+  // compressed files are kept for rotating files, and the oldest are also
+  // removed once they take more than maxTotalSize bytes if it is not 0;
+  // compressed daily files are only limited by maxTotalSize
+  //
+  // single files are never rotated, this is the same as setFile() for them
+  //
+  void setCompressedFile(const File& f, std::uintmax_t maxTotalSize = 0);
+
   void setCallback(Callback* f);
 
+  // called for each line, like setCallback(), but with views into buffers
+  // owned by the logger, so nothing is allocated once they have grown
+  //
+  void setViewCallback(ViewCallback* f);
+
+  // called on a background thread every `interval`, and on the calling thread
+  // by flush(), with all the lines logged since the previous call; the views
+  // are only valid during the call; flushes triggered by the flush level do
+  // not deliver anything
+  //
+  // this replaces the previous batch callback, null removes it and delivers
+  // the remaining lines
+  //
+  void setBatchCallback(BatchCallback* f, std::chrono::milliseconds interval);
+
+  // keeps the last messages of each thread in memory, whatever the level of
+  // the logger, and dumps them when an error is logged or on
+  // dumpFlightRecorder(); replaces the current recorder, a capacity of 0
+  // disables it
+  //
+  void setFlightRecorder(FlightRecorderConfiguration conf);
+
+  // dumps the messages recorded since the last dump, if any
+  //
+  void dumpFlightRecorder();
+
   void addToBlacklist(const std::string& filter, const std::string& replacement);
   void removeFromBlacklist(const std::string& filter);
   void resetBlacklist();
@@ -251,30 +406,252 @@ public:
     requires(details::RuntimeFormatString<F, Args...>)
   void log(Levels lv, F&& format, Args&&... args) noexcept
   {
-    details::doLog(*m_logger, lv, m_conf.blacklist, std::forward<F>(format),
-                   std::forward<Args>(args)...);
+    if (!formatted(lv)) {
+      return;
+    }
+
+    logMessage(lv, details::formatMessage(lv, std::forward<F>(format),
+                                          std::forward<Args>(args)...));
   }
 
   template <class... Args>
   void log(Levels lv, std::format_string<Args...> format, Args&&... args) noexcept
   {
-    details::doLog(*m_logger, lv, m_conf.blacklist, format,
-                   std::forward<Args>(args)...);
+    if (!formatted(lv) || throttled(lv, format.get())) {
+      return;
+    }
+
+    logMessage(lv, details::formatMessage(lv, format, std::forward<Args>(args)...));
+  }
+
+  // logs a message built at runtime, rate limited as the given call site
+  // instead of by its format string, see log::lazy()
+  //
+  void logAt(const std::source_location& site, Levels lv,
+             std::string message) noexcept;
+
+  // logs a message formatted elsewhere, such as by a BinaryLogger, with its
+  // original time; it is rate limited like log() with the given format string,
+  // if any
+  //
+  void logForwarded(Levels lv, std::chrono::system_clock::time_point time,
+                    std::string_view format, std::string message) noexcept;
+
+  // logs a message of a category, see log::category(); the level of the
+  // category has already been checked and replaces the one of the logger
+  //
+  template <class F, class... Args>
+    requires(details::RuntimeFormatString<F, Args...>)
+  void logCategory(std::string_view category, Levels lv, F&& format,
+                   Args&&... args) noexcept
+  {
+    logCategoryMessage(category, lv,
+                       details::formatMessage(lv, std::forward<F>(format),
+                                              std::forward<Args>(args)...));
   }
 
+  template <class... Args>
+  void logCategory(std::string_view category, Levels lv,
+                   std::format_string<Args...> format, Args&&... args) noexcept
+  {
+    if (throttled(lv, format.get())) {
+      return;
+    }
+
+    logCategoryMessage(category, lv,
+                       details::formatMessage(lv, format, std::forward<Args>(args)...));
+  }
+
+  void logCategoryAt(const std::source_location& site, std::string_view category,
+                     Levels lv, std::string message) noexcept;
+
 private:
+  friend class details::LoggerImpl;
+
+  // these members keep their original layout, the inline functions of plugins
+  // built against older versions of this header use m_conf.blacklist and
+  // m_logger directly, see details::doLogImpl()
   LoggerConfiguration m_conf;
   std::unique_ptr<spdlog::logger> m_logger;
   std::shared_ptr<spdlog::sinks::sink> m_sinks;
   std::shared_ptr<spdlog::sinks::sink> m_console, m_callback, m_file;
 
+  // everything else
+  std::unique_ptr<details::LoggerImpl> m_impl;
+
+  // whether messages of the given level are either logged or recorded
+  //
+  bool formatted(Levels lv) const noexcept;
+
+  // whether the rate limit of the call site with the given format string has
+  // been reached, always false if rate limiting is disabled
+  //
+  bool throttled(Levels lv, std::string_view format) noexcept;
+
+  // applies the blacklist to a formatted message, then records, dumps and logs
+  // it as needed
+  //
+  void logMessage(Levels lv, std::string message) noexcept;
+
+  // same, but prefixes the message with the category and logs it regardless
+  // of the level of the logger
+  //
+  void logCategoryMessage(std::string_view category, Levels lv,
+                          std::string message) noexcept;
+
   void createLogger(const std::string& name);
+  void compileBlacklist();
   void addSink(std::shared_ptr<spdlog::sinks::sink> sink);
 };
 
 QDLLEXPORT void createDefault(LoggerConfiguration conf);
+QDLLEXPORT void createDefault(LoggerConfiguration conf, LoggerOptions options);
 QDLLEXPORT Logger& getDefault();
 
+// whether messages of the given level are logged by the default logger
+//
+inline bool enabled(Levels lv) noexcept
+{
+  return getDefault().enabled(lv);
+}
+
+// a named subsystem that logs through the default logger, prefixing its
+// messages with its name, but with its own level; see category()
+//
+class QDLLEXPORT Category
+{
+public:
+  Category(std::string name);
+
+  Category(const Category&)            = delete;
+  Category& operator=(const Category&) = delete;
+
+  const std::string& name() const;
+
+  // the level of the category, or nullopt if it follows the default logger
+  //
+  std::optional<Levels> level() const;
+  void setLevel(std::optional<Levels> lv);
+
+  bool enabled(Levels lv) const noexcept
+  {
+    if (!compiledIn(lv)) {
+      return false;
+    }
+
+    const auto level = m_level.load(std::memory_order_relaxed);
+
+    if (level == FollowDefault) {
+      return getDefault().enabled(lv);
+    }
+
+    return lv >= level;
+  }
+
+  template <class F, class... Args>
+    requires(details::RuntimeFormatString<F, Args...>)
+  void debug(F&& format, Args&&... args) noexcept
+  {
+    log(Debug, std::forward<F>(format), std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  void debug(std::format_string<Args...> format, Args&&... args) noexcept
+  {
+    log(Debug, format, std::forward<Args>(args)...);
+  }
+
+  template <class F, class... Args>
+    requires(details::RuntimeFormatString<F, Args...>)
+  void info(F&& format, Args&&... args) noexcept
+  {
+    log(Info, std::forward<F>(format), std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  void info(std::format_string<Args...> format, Args&&... args) noexcept
+  {
+    log(Info, format, std::forward<Args>(args)...);
+  }
+
+  template <class F, class... Args>
+    requires(details::RuntimeFormatString<F, Args...>)
+  void warn(F&& format, Args&&... args) noexcept
+  {
+    log(Warning, std::forward<F>(format), std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  void warn(std::format_string<Args...> format, Args&&... args) noexcept
+  {
+    log(Warning, format, std::forward<Args>(args)...);
+  }
+
+  template <class F, class... Args>
+    requires(details::RuntimeFormatString<F, Args...>)
+  void error(F&& format, Args&&... args) noexcept
+  {
+    log(Error, std::forward<F>(format), std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  void error(std::format_string<Args...> format, Args&&... args) noexcept
+  {
+    log(Error, format, std::forward<Args>(args)...);
+  }
+
+  template <class F, class... Args>
+    requires(details::RuntimeFormatString<F, Args...>)
+  void log(Levels lv, F&& format, Args&&... args) noexcept
+  {
+    if (!enabled(lv)) {
+      return;
+    }
+
+    getDefault().logCategory(m_name, lv, std::forward<F>(format),
+                             std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  void log(Levels lv, std::format_string<Args...> format, Args&&... args) noexcept
+  {
+    if (!enabled(lv)) {
+      return;
+    }
+
+    getDefault().logCategory(m_name, lv, format, std::forward<Args>(args)...);
+  }
+
+  void logAt(const std::source_location& site, Levels lv,
+             std::string message) noexcept
+  {
+    if (!enabled(lv)) {
+      return;
+    }
+
+    getDefault().logCategoryAt(site, m_name, lv, std::move(message));
+  }
+
+private:
+  static constexpr int FollowDefault = -1;
+
+  std::string m_name;
+  std::atomic<int> m_level;
+};
+
+// returns the category with the given name, created on first use with the
+// level given to the last setCategoryLevel() call matching its name; the
+// reference stays valid for the lifetime of the program, so it can be kept in
+// a static variable to avoid the lookup
+//
+QDLLEXPORT Category& category(std::string_view name);
+
+// sets the level of all the categories matching the given pattern, which can
+// contain '*' wildcards and is case-insensitive, including categories created
+// later; nullopt makes them follow the default logger again
+//
+QDLLEXPORT void setCategoryLevel(std::string_view pattern, std::optional<Levels> lv);
+
 template <class F, class... Args>
   requires(details::RuntimeFormatString<F, Args...>)
 void debug(F&& format, Args&&... args) noexcept
@@ -340,7 +717,56 @@ void log(Levels lv, std::format_string<Args...> format, Args&&... args) noexcept
   getDefault().log(lv, format, std::forward<Args>(args)...);
 }
 
+// calls f only if the level is enabled for the given Logger or Category, and
+// logs what it returns; f is never called below UIBASE_LOG_MIN_LEVEL
+//
+// each call of lazy() is its own call site for the rate limit
+//
+template <Levels lv, class Target, class F>
+void lazy(Target& target, F&& f,
+          std::source_location site = std::source_location::current()) noexcept
+{
+  if constexpr (compiledIn(lv)) {
+    if (target.enabled(lv)) {
+      try {
+        target.logAt(site, lv, std::format("{}", std::forward<F>(f)()));
+      } catch (...) {
+        // eat it
+      }
+    }
+  }
+}
+
+template <Levels lv, class F>
+void lazy(F&& f, std::source_location site = std::source_location::current()) noexcept
+{
+  lazy<lv>(getDefault(), std::forward<F>(f), site);
+}
+
 //
 QDLLEXPORT QString levelToString(Levels level);
 
 }  // namespace MOBase::log
+
+// logs to the given Logger or Category; the arguments are only evaluated if the
+// level is enabled, and the statement compiles to nothing below
+// UIBASE_LOG_MIN_LEVEL; the level must be a constant
+//
+#define MO_LOG_TO(target, lv, ...)                                             \
+  do {                                                                         \
+    if constexpr (::MOBase::log::compiledIn(lv)) {                             \
+      auto&& moLogTarget = (target);                                           \
+      if (moLogTarget.enabled(lv)) {                                           \
+        moLogTarget.log(lv, __VA_ARGS__);                                      \
+      }                                                                        \
+    }                                                                          \
+  } while (false)
+
+#define MO_LOG_DEBUG(...)                                                      \
+  MO_LOG_TO(::MOBase::log::getDefault(), ::MOBase::log::Debug, __VA_ARGS__)
+#define MO_LOG_INFO(...)                                                       \
+  MO_LOG_TO(::MOBase::log::getDefault(), ::MOBase::log::Info, __VA_ARGS__)
+#define MO_LOG_WARN(...)                                                       \
+  MO_LOG_TO(::MOBase::log::getDefault(), ::MOBase::log::Warning, __VA_ARGS__)
+#define MO_LOG_ERROR(...)                                                      \
+  MO_LOG_TO(::MOBase::log::getDefault(), ::MOBase::log::Error, __VA_ARGS__)
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+
+#include <QString>
+#include <QStringView>
+
+#include "dllimport.h"
+
+// string interning
+//
+// names repeated across many objects (directory names, plugin names, etc.) can
+// be interned so that they share a single payload; an interned string is a
+// regular QString that shares its data with the copy kept by a global pool, so
+// it can be stored wherever a QString is without changing the type
+//
+// the pool is sharded by hash and thread-safe; a string that is not used
+// outside of the pool anymore is removed the next time its shard is swept,
+// which happens when the shard has doubled in size since the last sweep
+//
+// most interned strings are file names, so the pool also keeps the FileNameHash
+// of each string, which FileNameHash uses instead of folding interned names again
+
+namespace MOBase
+{
+
+// returns a string equal to the given one, sharing its data with the other
+// strings interned with the same contents; empty strings are not pooled
+//
+QDLLEXPORT QString internString(QStringView s);
+
+// returns the FileNameHash of the given string if it is the data of an interned
+// string, i.e., a view of a string returned by internString(); other strings,
+// including equal ones that are not shared with the pool, return nothing
+//
+QDLLEXPORT std::optional<std::size_t> internedFileNameHash(QStringView s);
+
+// removes the strings that are not used outside of the pool anymore and
+// returns the number of distinct strings left
+//
+QDLLEXPORT std::size_t internedStringCount();
+
+}  // namespace MOBase
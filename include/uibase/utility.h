@@ -21,6 +21,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #ifndef MO_UIBASE_UTILITY_INCLUDED
 #define MO_UIBASE_UTILITY_INCLUDED
 
+#include <QCollatorSortKey>
 #include <QDir>
 #include <QIcon>
 #include <QList>
@@ -31,7 +32,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <ShlObj.h>
 #include <Windows.h>
 #include <algorithm>
+#include <functional>
+#include <iterator>
+#include <ranges>
 #include <set>
+#include <utility>
 #include <vector>
 
 #include "dllimport.h"
@@ -420,6 +425,50 @@ private:
   Qt::CaseSensitivity m_cs;
 };
 
+// returns a key that compares like naturalCompare(), for sorting many strings
+// without collating them again on each comparison
+//
+// naturalCompare() and naturalSortKey() use collators local to the calling
+// thread, so they can be used from any thread
+//
+QDLLEXPORT QCollatorSortKey naturalSortKey(const QString& s,
+                                           Qt::CaseSensitivity cs = Qt::CaseInsensitive);
+
+// sorts the given range naturally (see naturalCompare()) by the string returned
+// by the projection for each element; the keys are computed once per element,
+// elements with equal keys keep their order
+//
+template <std::ranges::random_access_range Range, class Projection = std::identity>
+void naturalSort(Range&& range, Projection projection = {},
+                 Qt::CaseSensitivity cs = Qt::CaseInsensitive)
+{
+  const auto first = std::ranges::begin(range);
+  const auto size  = static_cast<std::size_t>(std::ranges::distance(range));
+
+  std::vector<std::pair<QCollatorSortKey, std::size_t>> keys;
+  keys.reserve(size);
+
+  for (std::size_t i = 0; i < size; ++i) {
+    keys.emplace_back(
+        naturalSortKey(std::invoke(projection, first[static_cast<std::ptrdiff_t>(i)]),
+                       cs),
+        i);
+  }
+
+  std::stable_sort(keys.begin(), keys.end(), [](auto&& a, auto&& b) {
+    return a.first.compare(b.first) < 0;
+  });
+
+  std::vector<std::ranges::range_value_t<Range>> sorted;
+  sorted.reserve(size);
+
+  for (auto&& [key, i] : keys) {
+    sorted.push_back(std::move(first[static_cast<std::ptrdiff_t>(i)]));
+  }
+
+  std::ranges::move(sorted, first);
+}
+
 /**
  * throws on failure
  * @param id    the folder id
@@ -24,6 +24,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "dllimport.h"
 #include <QList>
 #include <QString>
+#include <compare>
 
 class QVersionNumber;
 
@@ -165,6 +166,11 @@ private:
    **/
   QString parseReleaseType(QString versionString);
 
+  /**
+   * @brief three-way comparison used by all the comparison operators
+   **/
+  static std::weak_ordering compare(const VersionInfo& LHS, const VersionInfo& RHS);
+
 private:
   VersionScheme m_Scheme;
 
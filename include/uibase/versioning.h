@@ -1,6 +1,8 @@
 #pragma once
 
 #include <compare>
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <variant>
 #include <vector>
@@ -94,6 +96,10 @@ public:
   };
   using enum ReleaseType;
 
+  // a pre-release identifier
+  //
+  using PreRelease = std::variant<int, ReleaseType>;
+
 public:  // parsing
   // parse version from the given string, throw InvalidVersionException if the string
   // cannot be parsed
@@ -114,8 +120,7 @@ public:  // constructors
           int prerelease, QString metadata = {});
 
   Version(int major, int minor, int patch, int subpatch,
-          std::vector<std::variant<int, ReleaseType>> prereleases,
-          QString metadata = {});
+          std::vector<PreRelease> prereleases, QString metadata = {});
 
 public:  // special member functions
   Version(const Version&) = default;
@@ -148,12 +153,19 @@ public:
   //
   QString string(const FormatModes& modes = {}) const;
 
+  // packed 64-bit key ordered like operator<=>, or nothing if this version does not
+  // fit in it (very large numbers, more than two pre-release numbers, etc.); sorting
+  // many versions can compute the keys once and compare integers, versions without
+  // a key must be compared with operator<=>
+  //
+  std::optional<std::uint64_t> sortKey() const;
+
 private:
   // major.minor.patch
   int m_Major, m_Minor, m_Patch, m_SubPatch;
 
   // pre-release information
-  std::vector<std::variant<int, ReleaseType>> m_PreReleases;
+  std::vector<PreRelease> m_PreReleases;
 
   // metadata
   QString m_BuildMetadata;
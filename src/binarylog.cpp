@@ -0,0 +1,757 @@
+#include "binarylog.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
+
+#pragma warning(push)
+#pragma warning(disable : 4365)
+#include <spdlog/details/os.h>
+#pragma warning(pop)
+
+namespace MOBase::log::details
+{
+
+namespace
+{
+
+// file layout: the magic, followed by frames made of the size of the body as
+// a 32-bit integer and the body, starting with a FrameType
+//
+// a message body contains the address of its format string, used as an id,
+// the time in nanoseconds since the epoch, the thread id, the level and the
+// number of arguments, followed by the format string itself the first time a
+// thread uses it (MessageWithFormat), and the arguments; a frame is written to
+// the ring buffer of a thread in one go, so frames are never split
+//
+constexpr std::array<char, 8> Magic = {'M', 'O', 'B', 'L', 'O', 'G', '\x01', '\n'};
+
+enum class FrameType : std::uint8_t
+{
+  Message = 1,
+  MessageWithFormat,
+
+  // number of messages dropped by a thread since the previous Dropped frame
+  Dropped
+};
+
+// single-producer, single-consumer ring buffer of frames owned by a thread
+//
+class ThreadBuffer
+{
+public:
+  ThreadBuffer(std::size_t capacity, std::uint64_t thread)
+      : m_data(std::bit_ceil(std::max<std::size_t>(capacity, 4096))),
+        m_mask(m_data.size() - 1), m_thread(thread)
+  {}
+
+  std::uint64_t thread() const { return m_thread; }
+
+  // producer, writes the given parts as a single frame, or nothing if there is
+  // not enough room
+  //
+  bool write(std::initializer_list<std::span<const std::byte>> parts)
+  {
+    std::size_t total = 0;
+    for (auto part : parts) {
+      total += part.size();
+    }
+
+    auto head       = m_head.load(std::memory_order_relaxed);
+    const auto tail = m_tail.load(std::memory_order_acquire);
+
+    if (m_data.size() - (head - tail) < total) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    for (auto part : parts) {
+      const auto pos   = head & m_mask;
+      const auto first = std::min(part.size(), m_data.size() - pos);
+      std::memcpy(m_data.data() + pos, part.data(), first);
+      std::memcpy(m_data.data(), part.data() + first, part.size() - first);
+      head += part.size();
+    }
+
+    m_head.store(head, std::memory_order_release);
+    return true;
+  }
+
+  // consumer, appends all the frames written so far
+  //
+  void read(std::vector<std::byte>& out)
+  {
+    const auto tail = m_tail.load(std::memory_order_relaxed);
+    const auto head = m_head.load(std::memory_order_acquire);
+
+    const auto size  = head - tail;
+    const auto pos   = tail & m_mask;
+    const auto first = std::min(size, m_data.size() - pos);
+    out.insert(out.end(), m_data.begin() + pos, m_data.begin() + pos + first);
+    out.insert(out.end(), m_data.begin(), m_data.begin() + (size - first));
+
+    m_tail.store(head, std::memory_order_release);
+  }
+
+  // format strings already written by this thread, producer only
+  std::unordered_set<const char*> formats;
+
+  std::atomic<std::uint64_t> dropped{0};
+
+  // dropped messages already reported, consumer only
+  std::uint64_t reported = 0;
+
+private:
+  std::vector<std::byte> m_data;
+  std::size_t m_mask;
+  std::uint64_t m_thread;
+
+  alignas(64) std::atomic<std::size_t> m_head{0};
+  alignas(64) std::atomic<std::size_t> m_tail{0};
+};
+
+// argument decoded from a frame, formatted with the specification of the
+// replacement field it is used in
+//
+struct DecodedArg
+{
+  // argument formatted on the logging thread, see BinaryArg::Formatted
+  struct Formatted
+  {
+    std::string text;
+  };
+
+  std::variant<std::monostate, std::int64_t, std::uint64_t, double, float, bool,
+               char, std::string, const void*, Formatted>
+      value;
+};
+
+}  // namespace
+
+}  // namespace MOBase::log::details
+
+template <>
+struct std::formatter<MOBase::log::details::DecodedArg, char>
+{
+  std::string spec;
+
+  auto parse(std::format_parse_context& ctx)
+  {
+    // nested replacement fields (dynamic width or precision) are not supported
+    auto it = ctx.begin();
+    while (it != ctx.end() && *it != '}') {
+      ++it;
+    }
+
+    spec.assign(ctx.begin(), it);
+    return it;
+  }
+
+  auto format(const MOBase::log::details::DecodedArg& arg,
+              std::format_context& ctx) const
+  {
+    return std::visit(
+        [&](const auto& v) -> std::format_context::iterator {
+          using T = std::decay_t<decltype(v)>;
+
+          if constexpr (std::is_same_v<T, std::monostate>) {
+            return ctx.out();
+          } else if constexpr (std::is_same_v<
+                                   T, MOBase::log::details::DecodedArg::Formatted>) {
+            return std::ranges::copy(v.text, ctx.out()).out;
+          } else if (spec.empty()) {
+            return std::format_to(ctx.out(), "{}", v);
+          } else {
+            return std::vformat_to(ctx.out(), "{:" + spec + "}",
+                                   std::make_format_args(v));
+          }
+        },
+        arg.value);
+  }
+};
+
+namespace MOBase::log::details
+{
+
+namespace
+{
+
+class Reader
+{
+public:
+  Reader(std::span<const std::byte> data) : m_data(data) {}
+
+  bool ok() const { return m_ok; }
+  bool atEnd() const { return m_pos == m_data.size(); }
+  std::size_t position() const { return m_pos; }
+
+  template <class T>
+  T read()
+  {
+    T value{};
+    if (auto bytes = take(sizeof(T)); bytes.size() == sizeof(T)) {
+      std::memcpy(&value, bytes.data(), sizeof(T));
+    }
+    return value;
+  }
+
+  std::span<const std::byte> take(std::size_t n)
+  {
+    if (!m_ok || m_data.size() - m_pos < n) {
+      m_ok = false;
+      return {};
+    }
+
+    auto bytes = m_data.subspan(m_pos, n);
+    m_pos += n;
+    return bytes;
+  }
+
+private:
+  std::span<const std::byte> m_data;
+  std::size_t m_pos = 0;
+  bool m_ok         = true;
+};
+
+struct DecodedMessage
+{
+  std::chrono::system_clock::time_point time;
+  Levels level;
+  std::uint64_t thread;
+  std::string message;
+
+  // owned by the decoder, empty for Dropped frames
+  std::string_view format;
+};
+
+class Decoder
+{
+public:
+  // decodes the complete frames at the start of the given data, returns the
+  // number of bytes used
+  //
+  template <class F>
+  std::size_t decode(std::span<const std::byte> data, F&& f)
+  {
+    Reader frames(data);
+    std::size_t used = 0;
+
+    while (!frames.atEnd()) {
+      const auto size = frames.read<std::uint32_t>();
+      auto body       = frames.take(size);
+      if (!frames.ok()) {
+        break;
+      }
+
+      used = frames.position();
+
+      DecodedMessage m;
+      if (decodeFrame(body, m)) {
+        f(std::move(m));
+      }
+    }
+
+    return used;
+  }
+
+private:
+  std::unordered_map<std::uint64_t, std::string> m_formats;
+
+  bool decodeFrame(std::span<const std::byte> body, DecodedMessage& m)
+  {
+    Reader r(body);
+    const auto type = static_cast<FrameType>(r.read<std::uint8_t>());
+
+    if (type == FrameType::Dropped) {
+      m.thread = r.read<std::uint64_t>();
+      m.time   = std::chrono::system_clock::now();
+      m.level  = Warning;
+
+      const auto n = r.read<std::uint64_t>();
+      m.message    = std::format("{} log messages dropped by thread {}", n, m.thread);
+      return r.ok();
+    }
+
+    if (type != FrameType::Message && type != FrameType::MessageWithFormat) {
+      return false;
+    }
+
+    const auto id   = r.read<std::uint64_t>();
+    const auto time = r.read<std::int64_t>();
+    m.thread        = r.read<std::uint64_t>();
+    m.level         = static_cast<Levels>(r.read<std::uint8_t>());
+    const auto argc = r.read<std::uint8_t>();
+
+    m.time = std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::nanoseconds(time)));
+
+    if (type == FrameType::MessageWithFormat) {
+      const auto length = r.read<std::uint32_t>();
+      const auto bytes  = r.take(length);
+      m_formats[id].assign(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    }
+
+    std::array<DecodedArg, MaxBinaryArgs> args;
+    for (std::size_t i = 0; i < argc && i < args.size(); ++i) {
+      args[i].value = decodeArg(r);
+    }
+
+    if (!r.ok()) {
+      return false;
+    }
+
+    auto format = m_formats.find(id);
+    if (format == m_formats.end()) {
+      m.message = "unknown format string in binary log";
+      return true;
+    }
+
+    m.format = format->second;
+
+    try {
+      m.message = std::vformat(
+          format->second,
+          std::make_format_args(args[0], args[1], args[2], args[3], args[4], args[5],
+                                args[6], args[7], args[8], args[9], args[10],
+                                args[11], args[12], args[13], args[14], args[15]));
+    } catch (std::exception&) {
+      m.message = "format error while decoding binary log: " + format->second;
+    }
+
+    return true;
+  }
+
+  static decltype(DecodedArg::value) decodeArg(Reader& r)
+  {
+    switch (static_cast<BinaryArg>(r.read<std::uint8_t>())) {
+    case BinaryArg::Int:
+      return r.read<std::int64_t>();
+
+    case BinaryArg::UInt:
+      return r.read<std::uint64_t>();
+
+    case BinaryArg::Double:
+      return r.read<double>();
+
+    case BinaryArg::Float:
+      return r.read<float>();
+
+    case BinaryArg::Bool:
+      return r.read<std::uint8_t>() != 0;
+
+    case BinaryArg::Char:
+      return r.read<char>();
+
+    case BinaryArg::String: {
+      const auto bytes = r.take(r.read<std::uint32_t>());
+      return std::string(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    }
+
+    case BinaryArg::QString: {
+      const auto length = r.read<std::uint32_t>();
+      const auto bytes  = r.take(std::size_t{length} * sizeof(char16_t));
+      return QString(reinterpret_cast<const QChar*>(bytes.data()),
+                     static_cast<qsizetype>(bytes.size() / sizeof(char16_t)))
+          .toStdString();
+    }
+
+    case BinaryArg::Pointer:
+      return reinterpret_cast<const void*>(r.read<std::uintptr_t>());
+
+    case BinaryArg::Formatted: {
+      const auto bytes = r.take(r.read<std::uint32_t>());
+      return DecodedArg::Formatted{
+          std::string(reinterpret_cast<const char*>(bytes.data()), bytes.size())};
+    }
+
+    default:
+      r.take(std::numeric_limits<std::size_t>::max());
+      return {};
+    }
+  }
+};
+
+// buffers of the current thread for each binary logger, identified by a
+// unique id since loggers can be destroyed and recreated at the same address
+//
+struct ThreadBuffers
+{
+  std::vector<std::pair<std::uint64_t, std::shared_ptr<ThreadBuffer>>> buffers;
+};
+
+thread_local ThreadBuffers t_buffers;
+
+std::atomic<std::uint64_t> g_nextLoggerId{1};
+
+}  // namespace
+
+std::vector<std::byte>& binaryScratch() noexcept
+{
+  thread_local std::vector<std::byte> scratch;
+  return scratch;
+}
+
+std::string_view binaryArgSpec(std::string_view format, std::size_t index) noexcept
+{
+  std::size_t next = 0;
+
+  for (std::size_t i = 0; i < format.size(); ++i) {
+    if (format[i] != '{') {
+      continue;
+    }
+
+    if (i + 1 < format.size() && format[i + 1] == '{') {
+      // escaped
+      ++i;
+      continue;
+    }
+
+    const auto end = format.find('}', i);
+    if (end == std::string_view::npos) {
+      break;
+    }
+
+    const auto field = format.substr(i + 1, end - i - 1);
+    const auto colon = field.find(':');
+    const auto id    = field.substr(0, colon);
+
+    // automatic or manual indexing, they cannot be mixed
+    std::size_t arg = next++;
+    if (!id.empty()) {
+      std::from_chars(id.data(), id.data() + id.size(), arg);
+    }
+
+    if (arg == index) {
+      if (colon == std::string_view::npos) {
+        return {};
+      }
+
+      const auto spec = field.substr(colon + 1);
+      return spec.find('{') == std::string_view::npos ? spec : std::string_view();
+    }
+
+    i = end;
+  }
+
+  return {};
+}
+
+}  // namespace MOBase::log::details
+
+namespace MOBase::log
+{
+
+using namespace details;
+
+class BinaryLogger::Impl
+{
+public:
+  Impl(BinaryLoggerConfiguration conf)
+      : m_conf(std::move(conf)), m_id(g_nextLoggerId.fetch_add(1))
+  {
+    if (!m_conf.file.empty()) {
+      m_file.open(m_conf.file, std::ios::binary | std::ios::trunc);
+
+      if (m_file) {
+        m_file.write(Magic.data(), Magic.size());
+      } else {
+        std::cerr << "failed to create binary log " << m_conf.file.string() << "\n";
+      }
+    }
+
+    m_thread = std::thread([this] {
+      std::unique_lock lock(m_stopMutex);
+      while (!m_stop) {
+        m_stopped.wait_for(lock, m_conf.interval, [this] {
+          return m_stop;
+        });
+
+        lock.unlock();
+        drain();
+        lock.lock();
+      }
+    });
+  }
+
+  ~Impl()
+  {
+    {
+      std::scoped_lock lock(m_stopMutex);
+      m_stop = true;
+    }
+
+    m_stopped.notify_all();
+    m_thread.join();
+
+    drain();
+  }
+
+  void submit(Levels lv, std::string_view format, std::size_t argCount,
+              const std::vector<std::byte>& args)
+  {
+    auto& buffer     = threadBuffer();
+    const bool known = buffer.formats.contains(format.data());
+
+    const auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::system_clock::now().time_since_epoch())
+                          .count();
+
+    std::size_t bodySize = 1 + 8 + 8 + 8 + 1 + 1 + args.size();
+    if (!known) {
+      bodySize += 4 + format.size();
+    }
+
+    std::array<std::byte, 64> header;
+    std::size_t n    = 0;
+    const auto write = [&](const auto& value) {
+      std::memcpy(header.data() + n, &value, sizeof(value));
+      n += sizeof(value);
+    };
+
+    write(static_cast<std::uint32_t>(bodySize));
+    write(known ? FrameType::Message : FrameType::MessageWithFormat);
+    write(reinterpret_cast<std::uint64_t>(format.data()));
+    write(static_cast<std::int64_t>(time));
+    write(buffer.thread());
+    write(static_cast<std::uint8_t>(lv));
+    write(static_cast<std::uint8_t>(argCount));
+    if (!known) {
+      write(static_cast<std::uint32_t>(format.size()));
+    }
+
+    const auto formatBytes =
+        known ? std::span<const std::byte>() : std::as_bytes(std::span(format));
+
+    if (buffer.write({std::span(header.data(), n), formatBytes, std::span(args)}) &&
+        !known) {
+      buffer.formats.insert(format.data());
+    }
+  }
+
+  // writes or forwards everything in the buffers
+  //
+  void drain()
+  {
+    std::scoped_lock drainLock(m_drainMutex);
+
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+      std::scoped_lock lock(m_buffersMutex);
+      buffers = m_buffers;
+    }
+
+    for (auto& buffer : buffers) {
+      // the buffer is only referenced here and in m_buffers once its thread has
+      // exited, check it before reading so nothing written after is lost
+      const bool exited = buffer.use_count() == 2;
+
+      m_frames.clear();
+      buffer->read(m_frames);
+
+      const auto dropped = buffer->dropped.load(std::memory_order_relaxed);
+      if (dropped > buffer->reported) {
+        appendDropped(buffer->thread(), dropped - buffer->reported);
+        buffer->reported = dropped;
+      }
+
+      process();
+
+      if (exited) {
+        std::scoped_lock lock(m_buffersMutex);
+        m_exitedDropped += dropped;
+        std::erase(m_buffers, buffer);
+      }
+    }
+
+    if (m_file) {
+      m_file.flush();
+    }
+  }
+
+  std::uint64_t dropped() const
+  {
+    std::scoped_lock lock(m_buffersMutex);
+
+    std::uint64_t n = m_exitedDropped;
+    for (auto& buffer : m_buffers) {
+      n += buffer->dropped.load(std::memory_order_relaxed);
+    }
+
+    return n;
+  }
+
+private:
+  BinaryLoggerConfiguration m_conf;
+  std::uint64_t m_id;
+
+  mutable std::mutex m_buffersMutex;
+  std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+  std::uint64_t m_exitedDropped = 0;
+
+  // used by drain() only
+  std::mutex m_drainMutex;
+  std::ofstream m_file;
+  Decoder m_decoder;
+  std::vector<std::byte> m_frames;
+
+  std::mutex m_stopMutex;
+  std::condition_variable m_stopped;
+  bool m_stop = false;
+  std::thread m_thread;
+
+  ThreadBuffer& threadBuffer()
+  {
+    auto& buffers = t_buffers.buffers;
+
+    for (auto& [id, buffer] : buffers) {
+      if (id == m_id) {
+        return *buffer;
+      }
+    }
+
+    // forget the buffers of loggers that have been destroyed
+    std::erase_if(buffers, [](auto&& p) {
+      return p.second.use_count() == 1;
+    });
+
+    auto buffer = std::make_shared<ThreadBuffer>(m_conf.bufferSize,
+                                                 spdlog::details::os::thread_id());
+    {
+      std::scoped_lock lock(m_buffersMutex);
+      m_buffers.push_back(buffer);
+    }
+
+    buffers.emplace_back(m_id, buffer);
+    return *buffer;
+  }
+
+  void appendDropped(std::uint64_t thread, std::uint64_t count)
+  {
+    const auto write = [this](const auto& value) {
+      writeBinary(m_frames, &value, sizeof(value));
+    };
+
+    write(static_cast<std::uint32_t>(1 + 8 + 8));
+    write(FrameType::Dropped);
+    write(thread);
+    write(count);
+  }
+
+  void process()
+  {
+    if (m_frames.empty()) {
+      return;
+    }
+
+    if (m_file) {
+      m_file.write(reinterpret_cast<const char*>(m_frames.data()),
+                   static_cast<std::streamsize>(m_frames.size()));
+    }
+
+    if (m_conf.target) {
+      // the format strings are owned by the decoder, so each one keeps the same
+      // address and is rate limited as its own call site
+      m_decoder.decode(m_frames, [this](DecodedMessage m) {
+        m_conf.target->logForwarded(m.level, m.time, m.format, std::move(m.message));
+      });
+    }
+  }
+};
+
+BinaryLogger::BinaryLogger(BinaryLoggerConfiguration conf)
+    : m_level(conf.maxLevel), m_impl(std::make_unique<Impl>(std::move(conf)))
+{}
+
+BinaryLogger::~BinaryLogger() = default;
+
+Levels BinaryLogger::level() const
+{
+  return m_level.load(std::memory_order_relaxed);
+}
+
+void BinaryLogger::setLevel(Levels lv)
+{
+  m_level.store(lv, std::memory_order_relaxed);
+}
+
+void BinaryLogger::flush()
+{
+  m_impl->drain();
+}
+
+std::uint64_t BinaryLogger::dropped() const
+{
+  return m_impl->dropped();
+}
+
+void BinaryLogger::submit(Levels lv, std::string_view format, std::size_t argCount,
+                          const std::vector<std::byte>& args) noexcept
+{
+  try {
+    m_impl->submit(lv, format, argCount, args);
+  } catch (...) {
+    // eat it
+  }
+}
+
+bool decodeBinaryLog(const std::filesystem::path& file,
+                     const std::function<void(Entry)>& callback)
+{
+  std::ifstream in(file, std::ios::binary);
+
+  std::array<char, Magic.size()> magic{};
+  if (!in.read(magic.data(), magic.size()) || magic != Magic) {
+    return false;
+  }
+
+  Decoder decoder;
+  std::vector<std::byte> data;
+  std::size_t used = 0;
+
+  const auto emit = [&callback](DecodedMessage m) {
+    Entry e;
+    e.time             = m.time;
+    e.level            = m.level;
+    e.formattedMessage = std::format(
+        "{:%Y-%m-%d %H:%M:%S} [{}] [{}] {}",
+        std::chrono::floor<std::chrono::milliseconds>(m.time), m.thread,
+        levelToString(m.level).toStdString(), m.message);
+    e.message = std::move(m.message);
+
+    callback(std::move(e));
+  };
+
+  // decode by chunks, keeping incomplete frames for the next chunk
+  for (;;) {
+    data.erase(data.begin(), data.begin() + used);
+
+    const auto offset = data.size();
+    data.resize(offset + (1 << 20));
+    in.read(reinterpret_cast<char*>(data.data() + offset), 1 << 20);
+    data.resize(offset + static_cast<std::size_t>(in.gcount()));
+
+    if (data.size() == offset) {
+      break;
+    }
+
+    used = decoder.decode(data, emit);
+  }
+
+  return true;
+}
+
+}  // namespace MOBase::log
@@ -0,0 +1,245 @@
+#include "flightrecorder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <mutex>
+#include <string>
+
+#pragma warning(push)
+#pragma warning(disable : 4365)
+#include <spdlog/details/os.h>
+#pragma warning(pop)
+
+namespace MOBase::log
+{
+
+namespace
+{
+
+// ring buffer of the last messages of a thread
+//
+// each slot is guarded by a sequence number, odd while the thread writes to
+// the slot and 2 * (index + 1) once the message with the given index is
+// complete; readers copy a slot and check that its sequence did not change in
+// the meantime, so the thread never waits for them
+//
+class Ring
+{
+public:
+  Ring(std::size_t capacity, std::size_t messageSize, std::uint64_t thread)
+      : m_slots(std::make_unique<Slot[]>(capacity)), m_capacity(capacity),
+        m_messageSize(messageSize), m_text(capacity * messageSize), m_thread(thread)
+  {}
+
+  std::uint64_t thread() const { return m_thread; }
+
+  // recording thread only
+  //
+  void write(Levels lv, std::string_view message)
+  {
+    const auto index = m_next.load(std::memory_order_relaxed);
+    auto& slot       = m_slots[index % m_capacity];
+
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const auto length = std::min(message.size(), m_messageSize);
+
+    slot.time.store(std::chrono::system_clock::now().time_since_epoch().count(),
+                    std::memory_order_relaxed);
+    slot.level.store(lv, std::memory_order_relaxed);
+    slot.length.store(length, std::memory_order_relaxed);
+    std::memcpy(text(index), message.data(), length);
+
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+    m_next.store(index + 1, std::memory_order_release);
+  }
+
+  // appends the messages recorded since the previous call and still in the
+  // ring
+  //
+  void read(std::vector<Entry>& out)
+  {
+    const auto next  = m_next.load(std::memory_order_acquire);
+    const auto first = std::max(m_taken, next > m_capacity ? next - m_capacity : 0);
+
+    for (auto index = first; index < next; ++index) {
+      auto& slot        = m_slots[index % m_capacity];
+      const auto before = slot.sequence.load(std::memory_order_acquire);
+
+      if (before != 2 * index + 2) {
+        // overwritten by a newer message
+        continue;
+      }
+
+      Entry e;
+      e.time = std::chrono::system_clock::time_point(
+          std::chrono::system_clock::duration(slot.time.load(std::memory_order_relaxed)));
+      e.level = slot.level.load(std::memory_order_relaxed);
+      e.message.assign(text(index), slot.length.load(std::memory_order_relaxed));
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) != before) {
+        continue;
+      }
+
+      out.push_back(std::move(e));
+    }
+
+    m_taken = next;
+  }
+
+private:
+  struct Slot
+  {
+    std::atomic<std::uint64_t> sequence{0};
+    std::atomic<std::chrono::system_clock::rep> time{0};
+    std::atomic<Levels> level{Debug};
+    std::atomic<std::size_t> length{0};
+  };
+
+  std::unique_ptr<Slot[]> m_slots;
+  std::size_t m_capacity, m_messageSize;
+  std::vector<char> m_text;
+  std::uint64_t m_thread;
+
+  // index of the next message, written by the recording thread only
+  std::atomic<std::uint64_t> m_next{0};
+
+  // index of the first message not returned by read() yet, reader only
+  std::uint64_t m_taken = 0;
+
+  char* text(std::uint64_t index)
+  {
+    return m_text.data() + (index % m_capacity) * m_messageSize;
+  }
+};
+
+// rings of the current thread for each recorder, identified by a unique id
+// since recorders can be destroyed and recreated at the same address
+//
+thread_local std::vector<std::pair<std::uint64_t, std::shared_ptr<Ring>>> t_rings;
+
+std::atomic<std::uint64_t> g_nextRecorderId{1};
+
+}  // namespace
+
+class FlightRecorder::Impl
+{
+public:
+  Impl(const FlightRecorderConfiguration& conf)
+      : m_capacity(std::max<std::size_t>(conf.capacity, 1)),
+        m_messageSize(std::max<std::size_t>(conf.messageSize, 1)),
+        m_id(g_nextRecorderId.fetch_add(1))
+  {}
+
+  void record(Levels lv, std::string_view message)
+  {
+    ring().write(lv, message);
+  }
+
+  std::vector<Entry> take()
+  {
+    std::scoped_lock lock(m_mutex);
+
+    std::vector<Entry> entries;
+
+    for (auto& r : m_rings) {
+      // the ring is only referenced here once its thread has exited, check it
+      // before reading so nothing recorded after is lost
+      const bool exited = r.use_count() == 1;
+      const auto begin  = entries.size();
+
+      r->read(entries);
+
+      for (auto i = begin; i < entries.size(); ++i) {
+        auto& e            = entries[i];
+        e.formattedMessage = std::format(
+            "{:%Y-%m-%d %H:%M:%S} [{}] [{}] {}",
+            std::chrono::floor<std::chrono::milliseconds>(e.time), r->thread(),
+            levelToString(e.level).toStdString(), e.message);
+      }
+
+      if (exited) {
+        r.reset();
+      }
+    }
+
+    std::erase(m_rings, nullptr);
+
+    // each ring is already in order, the stable sort keeps the order of
+    // messages recorded at the same time by a thread
+    std::stable_sort(entries.begin(), entries.end(), [](auto&& a, auto&& b) {
+      return a.time < b.time;
+    });
+
+    return entries;
+  }
+
+private:
+  std::size_t m_capacity, m_messageSize;
+  std::uint64_t m_id;
+
+  std::mutex m_mutex;
+  std::vector<std::shared_ptr<Ring>> m_rings;
+
+  Ring& ring()
+  {
+    for (auto& [id, r] : t_rings) {
+      if (id == m_id) {
+        return *r;
+      }
+    }
+
+    // forget the rings of recorders that have been destroyed
+    std::erase_if(t_rings, [](auto&& p) {
+      return p.second.use_count() == 1;
+    });
+
+    auto r = std::make_shared<Ring>(m_capacity, m_messageSize,
+                                    spdlog::details::os::thread_id());
+    {
+      std::scoped_lock lock(m_mutex);
+      m_rings.push_back(r);
+    }
+
+    t_rings.emplace_back(m_id, r);
+    return *r;
+  }
+};
+
+FlightRecorder::FlightRecorder(FlightRecorderConfiguration conf)
+    : m_conf(std::move(conf)), m_impl(std::make_unique<Impl>(m_conf))
+{}
+
+FlightRecorder::~FlightRecorder() = default;
+
+const FlightRecorderConfiguration& FlightRecorder::configuration() const
+{
+  return m_conf;
+}
+
+bool FlightRecorder::records(Levels lv) const noexcept
+{
+  return lv >= m_conf.level && lv < Error;
+}
+
+void FlightRecorder::record(Levels lv, std::string_view message) noexcept
+{
+  try {
+    m_impl->record(lv, message);
+  } catch (...) {
+    // eat it
+  }
+}
+
+std::vector<Entry> FlightRecorder::take()
+{
+  return m_impl->take();
+}
+
+}  // namespace MOBase::log
@@ -1,17 +1,213 @@
 #include "ifiletree.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <ranges>
+#include <set>
 #include <span>
 #include <stack>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <QRegularExpression>
 
+#include "stringpool.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define UIBASE_FILENAME_SSE2 1
+#include <emmintrin.h>
+#else
+#define UIBASE_FILENAME_SSE2 0
+#endif
+
+// FileNameHash and FileNameEqual:
+namespace MOBase
+{
+
+namespace
+{
+
+  // names are hashed 4 UTF-16 units at a time, the units must already be folded
+  // so that names made only of ASCII characters, folded while being hashed, and
+  // other names, case-folded beforehand, end up with the same hash
+  //
+  std::uint64_t mixFileName(std::uint64_t h, std::uint64_t word)
+  {
+    h ^= word;
+    h *= 0x9e3779b97f4a7c15ull;
+    return h ^ (h >> 29);
+  }
+
+  constexpr char16_t foldFileNameUnit(char16_t c)
+  {
+    return (c >= u'A' && c <= u'Z') ? static_cast<char16_t>(c + (u'a' - u'A')) : c;
+  }
+
+  std::uint64_t packFileNameUnits(const char16_t* p, std::size_t n)
+  {
+    std::uint64_t word = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      word |= static_cast<std::uint64_t>(foldFileNameUnit(p[i])) << (16 * i);
+    }
+    return word;
+  }
+
+#if UIBASE_FILENAME_SSE2
+  // returns the units folded, or false if one of them is not ASCII
+  //
+  bool foldFileNameAscii(__m128i& units)
+  {
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(
+            _mm_and_si128(units, _mm_set1_epi16(static_cast<short>(0xff80))),
+            _mm_setzero_si128())) != 0xffff) {
+      return false;
+    }
+
+    const auto upper = _mm_and_si128(_mm_cmpgt_epi16(units, _mm_set1_epi16('A' - 1)),
+                                     _mm_cmplt_epi16(units, _mm_set1_epi16('Z' + 1)));
+    units = _mm_or_si128(units, _mm_and_si128(upper, _mm_set1_epi16(0x20)));
+
+    return true;
+  }
+#endif
+
+  // hashes the given units, folding them if ascii is true; returns false if ascii
+  // is true and one of the units is not ASCII
+  //
+  bool hashFileName(QStringView name, bool ascii, std::uint64_t& out)
+  {
+    const auto* p = name.utf16();
+    const auto n  = static_cast<std::size_t>(name.size());
+
+    std::uint64_t h = 0xcbf29ce484222325ull ^ n;
+    std::size_t i   = 0;
+
+#if UIBASE_FILENAME_SSE2
+    if (ascii) {
+      for (; i + 8 <= n; i += 8) {
+        auto units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        if (!foldFileNameAscii(units)) {
+          return false;
+        }
+
+        h = mixFileName(h, static_cast<std::uint64_t>(_mm_cvtsi128_si64(units)));
+        h = mixFileName(h, static_cast<std::uint64_t>(
+                               _mm_cvtsi128_si64(_mm_unpackhi_epi64(units, units))));
+      }
+    }
+#endif
+
+    for (; i < n; i += 4) {
+      const auto count = std::min<std::size_t>(4, n - i);
+
+      if (ascii && std::any_of(p + i, p + i + count, [](char16_t c) {
+            return c >= 0x80;
+          })) {
+        return false;
+      }
+
+      h = mixFileName(h, packFileNameUnits(p + i, count));
+    }
+
+    out = h ^ (h >> 32);
+    return true;
+  }
+
+  enum class FileNameAscii
+  {
+    Equal,
+    Different,
+    NonAscii
+  };
+
+  FileNameAscii equalsFileNameAscii(QStringView lhs, QStringView rhs)
+  {
+    const auto* a = lhs.utf16();
+    const auto* b = rhs.utf16();
+    const auto n  = static_cast<std::size_t>(lhs.size());
+
+    std::size_t i = 0;
+
+#if UIBASE_FILENAME_SSE2
+    for (; i + 8 <= n; i += 8) {
+      auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+      auto y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+
+      if (!foldFileNameAscii(x) || !foldFileNameAscii(y)) {
+        return FileNameAscii::NonAscii;
+      }
+
+      if (_mm_movemask_epi8(_mm_cmpeq_epi16(x, y)) != 0xffff) {
+        return FileNameAscii::Different;
+      }
+    }
+#endif
+
+    for (; i < n; ++i) {
+      if (a[i] >= 0x80 || b[i] >= 0x80) {
+        return FileNameAscii::NonAscii;
+      }
+
+      if (foldFileNameUnit(a[i]) != foldFileNameUnit(b[i])) {
+        return FileNameAscii::Different;
+      }
+    }
+
+    return FileNameAscii::Equal;
+  }
+
+}  // namespace
+
+std::size_t FileNameHash::operator()(QStringView name) const
+{
+  if (const auto interned = internedFileNameHash(name)) {
+    return *interned;
+  }
+
+  std::uint64_t h = 0;
+  if (hashFileName(name, true, h)) {
+    return static_cast<std::size_t>(h);
+  }
+
+  // case-folding can change characters outside of ASCII into ASCII ones, e.g., the
+  // Kelvin sign, so the whole name is folded
+  const auto folded = name.toString().toCaseFolded();
+  hashFileName(folded, false, h);
+
+  return static_cast<std::size_t>(h);
+}
+
+bool FileNameEqual::operator()(QStringView lhs, QStringView rhs) const
+{
+  if (lhs.size() == rhs.size()) {
+    // interned names with the same contents share their data
+    if (lhs.data() == rhs.data()) {
+      return true;
+    }
+
+    switch (equalsFileNameAscii(lhs, rhs)) {
+    case FileNameAscii::Equal:
+      return true;
+
+    case FileNameAscii::Different:
+      return false;
+
+    case FileNameAscii::NonAscii:
+    default:
+      break;
+    }
+  }
+
+  return lhs.compare(rhs, FileNameComparator::CaseSensitivity) == 0;
+}
+
+}  // namespace MOBase
+
 // FileTreeEntry:
 namespace MOBase
 {
 FileTreeEntry::FileTreeEntry(std::shared_ptr<const IFileTree> parent, QString name)
-    : m_Parent(parent), m_Name(name)
+    : m_Parent(parent), m_Name(internString(name))
 {}
 
 QString FileTreeEntry::suffix() const
@@ -22,12 +218,15 @@ QString FileTreeEntry::suffix() const
 
 bool FileTreeEntry::hasSuffix(QString suffix) const
 {
-  return this->suffix().compare(suffix, FileNameComparator::CaseSensitivity) == 0;
+  return FileNameEqual{}(this->suffix(), suffix);
 }
 
 bool FileTreeEntry::hasSuffix(QStringList suffixes) const
 {
-  return suffixes.contains(suffix(), FileNameComparator::CaseSensitivity);
+  const auto suffix = this->suffix();
+  return std::any_of(suffixes.begin(), suffixes.end(), [&suffix](auto&& s) {
+    return FileNameEqual{}(suffix, s);
+  });
 }
 
 QString FileTreeEntry::pathFrom(std::shared_ptr<const IFileTree> tree,
@@ -72,7 +271,15 @@ std::shared_ptr<FileTreeEntry> FileTreeEntry::clone() const
 std::shared_ptr<FileTreeEntry>
 FileTreeEntry::createFileEntry(std::shared_ptr<const IFileTree> parent, QString name)
 {
-  return std::shared_ptr<FileTreeEntry>(new FileTreeEntry(parent, name));
+  // Files are by far the most common entries, so allocate the entry and its control
+  // block together - make_shared needs a public constructor:
+  struct SharedFileTreeEntry : FileTreeEntry
+  {
+    SharedFileTreeEntry(std::shared_ptr<const IFileTree> parent, QString name)
+        : FileTreeEntry(std::move(parent), std::move(name))
+    {}
+  };
+  return std::make_shared<SharedFileTreeEntry>(std::move(parent), std::move(name));
 }
 }  // namespace MOBase
 
@@ -99,32 +306,70 @@ struct FileEntryComparator
 };
 
 /**
- * @brief Comparator that can be used to find entry matching the given name and
- *     file type.
+ * @brief Find the first entry matching the given name and file types.
+ *
+ * Entries are kept sorted (directories first, then by name), so this only performs
+ * binary searches over the directory and file partitions instead of a linear scan,
+ * which matters for directories with tens of thousands of entries.
+ *
+ * @param first, last Range of sorted entries.
+ * @param name Name of the entry to find.
+ * @param matchTypes Types of entry to look for.
+ *
+ * @return an iterator to the matching entry, or last if there is none.
  */
-struct MatchEntryComparator
+template <class It>
+It findEntry(It first, It last, QString const& name,
+             FileTreeEntry::FileTypes matchTypes)
 {
+  const auto middle = std::partition_point(first, last, [](auto const& entry) {
+    return entry->isDir();
+  });
 
-  MatchEntryComparator(QString const& name, FileTreeEntry::FileTypes matchTypes)
-      : m_Name(name), m_MatchTypes(matchTypes)
-  {}
+  const auto search = [&name, last](It begin, It end) {
+    auto it = std::lower_bound(begin, end, name,
+                               [](auto const& entry, QString const& value) {
+                                 return entry->compare(value) < 0;
+                               });
+    return (it != end && (*it)->compare(name) == 0) ? it : last;
+  };
+
+  if (matchTypes.testFlag(FileTreeEntry::DIRECTORY)) {
+    if (auto it = search(first, middle); it != last) {
+      return it;
+    }
+  }
 
-  bool operator()(const std::shared_ptr<const FileTreeEntry>& fileEntry) const
-  {
-    return m_MatchTypes.testFlag(fileEntry->fileType()) &&
-           fileEntry->compare(m_Name) == 0;
+  if (matchTypes.testFlag(FileTreeEntry::FILE)) {
+    return search(middle, last);
   }
 
-  bool operator()(const std::shared_ptr<FileTreeEntry>& fileEntry) const
-  {
-    return m_MatchTypes.testFlag(fileEntry->fileType()) &&
-           fileEntry->compare(m_Name) == 0;
+  return last;
+}
+
+/**
+ * @brief Find the given entry in the given range of sorted entries.
+ *
+ * @param first, last Range of sorted entries.
+ * @param entry Entry to find.
+ *
+ * @return an iterator to the entry, or last if the entry is not in the range.
+ */
+template <class It>
+It findEntry(It first, It last, std::shared_ptr<FileTreeEntry> const& entry)
+{
+  const auto name = entry->name();
+  for (auto it = findEntry(first, last, name, entry->fileType());
+       it != last && (*it)->compare(name) == 0; ++it) {
+    if (*it == entry) {
+      return it;
+    }
   }
 
-private:
-  QString const& m_Name;
-  FileTreeEntry::FileTypes m_MatchTypes;
-};
+  // The entry is not at its sorted position, e.g., if it was renamed and is being
+  // removed from its previous parent, so we fall back to a linear search:
+  return std::find(first, last, entry);
+}
 
 /**
  *
@@ -261,12 +506,22 @@ IFileTree::iterator IFileTree::insert(std::shared_ptr<FileTreeEntry> entry,
   }
 
   // Check if there exists an entry with the same name:
-  auto existingIt = std::find_if(
-      begin(), end(), MatchEntryComparator{entry->name(), FILE_OR_DIRECTORY});
+  auto existingIt = findEntry(begin(), end(), entry->name(), FILE_OR_DIRECTORY);
 
-  // Already in the tree?
+  // Already in the tree? The entry may have been renamed to the name of another
+  // entry, in which case that other entry is the actual conflict:
   if (existingIt != end() && *existingIt == entry) {
-    return existingIt;
+    auto conflictIt = existingIt + 1;
+    if (conflictIt == end() || (*conflictIt)->compare(entry->name()) != 0) {
+      conflictIt = findEntry(begin(), end(), entry->name(),
+                             entry->isDir() ? FILE : DIRECTORY);
+    }
+
+    if (conflictIt == end()) {
+      return existingIt;
+    }
+
+    existingIt = conflictIt;
   }
 
   auto insertionIt = end();
@@ -304,16 +559,28 @@ IFileTree::iterator IFileTree::insert(std::shared_ptr<FileTreeEntry> entry,
   } else if (beforeInsert(this, entry.get())) {
     insertionIt = entries().insert(
         std::lower_bound(begin(), end(), entry, FileEntryComparator{}), entry);
+  } else {
+    return end();
   }
 
+  const bool inserted = *insertionIt == entry;
+
   // Remove the tree from its parent (parent() can be null if we are inserting
   // a new tree):
-  if (entry->parent() != nullptr) {
-    entry->parent()->erase(entry);
+  if (auto oldParent = entry->parent(); oldParent != nullptr) {
+    oldParent->erase(entry);
+
+    // If the entry was renamed inside this tree, it was just removed from the same
+    // vector, so the insertion iterator may have been shifted:
+    if (oldParent.get() == this) {
+      insertionIt =
+          inserted ? findEntry(begin(), end(), entry)
+                   : findEntry(begin(), end(), entry->name(), FILE_OR_DIRECTORY);
+    }
   }
 
   // If the entry was actually inserted, we update its parent:
-  if (*insertionIt == entry) {
+  if (inserted) {
     entry->m_Parent = astree();
   }
   // Otherwize, we reset it (if this was a merge operation):
@@ -352,7 +619,7 @@ bool IFileTree::move(std::shared_ptr<FileTreeEntry> entry, QString path,
   // name:
   QString entryName = entry->m_Name;
   if (!insertFolder) {
-    entry->m_Name = parts.takeLast();
+    renameEntry(entry, parts.takeLast());
   }
 
   // Find or create the tree:
@@ -365,6 +632,7 @@ bool IFileTree::move(std::shared_ptr<FileTreeEntry> entry, QString path,
 
     // Early fail if the tree was not created:
     if (treeEntry == nullptr) {
+      renameEntry(entry, entryName);
       return false;
     }
 
@@ -376,7 +644,7 @@ bool IFileTree::move(std::shared_ptr<FileTreeEntry> entry, QString path,
   // We try to insert, and if it fails we need to reset the name:
   auto it = tree->insert(entry, insertPolicy);
   if (it == tree->end()) {
-    entry->m_Name = entryName;
+    renameEntry(entry, entryName);
     return false;
   }
 
@@ -430,7 +698,7 @@ IFileTree::iterator IFileTree::erase(std::shared_ptr<FileTreeEntry> entry)
     return end();
   }
 
-  auto it = std::find(begin(), end(), entry);
+  auto it = findEntry(begin(), end(), entry);
   if (it == end()) {
     return it;
   }
@@ -445,9 +713,7 @@ IFileTree::iterator IFileTree::erase(std::shared_ptr<FileTreeEntry> entry)
 std::pair<IFileTree::iterator, std::shared_ptr<FileTreeEntry>>
 IFileTree::erase(QString name)
 {
-  auto it = std::find_if(begin(), end(), [&name](const auto& entry) {
-    return entry->compare(name) == 0;
-  });
+  auto it = findEntry(begin(), end(), name, FILE_OR_DIRECTORY);
 
   if (it == end()) {
     return {it, nullptr};
@@ -485,8 +751,9 @@ bool IFileTree::clear()
  */
 std::size_t IFileTree::removeAll(QStringList names)
 {
-  return removeIf([&names](auto& entry) {
-    return names.contains(entry->name(), Qt::CaseInsensitive);
+  const FileNameSet set(names.begin(), names.end());
+  return removeIf([&set](auto& entry) {
+    return set.contains(entry->name());
   });
 }
 
@@ -507,6 +774,141 @@ std::size_t IFileTree::removeIf(
   return osize - size();
 }
 
+/**
+ *
+ */
+std::size_t
+IFileTree::removeEntries(std::span<const std::shared_ptr<FileTreeEntry>> entries)
+{
+  std::unordered_set<const FileTreeEntry*> removed;
+  for (auto& entry : entries) {
+    if (entry != nullptr && !removed.contains(entry.get()) &&
+        entry->parent().get() == this && beforeRemove(this, entry.get())) {
+      removed.insert(entry.get());
+    }
+  }
+
+  return detachAll(removed);
+}
+
+std::size_t
+IFileTree::detachAll(std::unordered_set<const FileTreeEntry*> const& detached)
+{
+  if (detached.empty()) {
+    return 0;
+  }
+
+  return std::erase_if(entries(), [&detached](const auto& entry) {
+    if (!detached.contains(entry.get())) {
+      return false;
+    }
+
+    entry->m_Parent.reset();
+    return true;
+  });
+}
+
+/**
+ *
+ */
+IFileTree::MemoryUsage IFileTree::memoryUsage() const
+{
+  // Estimate of a control block: vtable pointer and the two reference counters.
+  constexpr std::size_t controlBlockSize = sizeof(void*) + 2 * sizeof(std::int32_t);
+
+  // Names are interned, so each distinct name is counted once:
+  std::unordered_set<const QChar*> seen;
+  const auto nameSize = [&seen](QString const& name) -> std::size_t {
+    if (name.isEmpty() || !seen.insert(name.constData()).second) {
+      return 0;
+    }
+    return sizeof(QArrayData) + (name.capacity() + 1) * sizeof(QChar);
+  };
+
+  MemoryUsage usage;
+  usage.nodes         = sizeof(IFileTree);
+  usage.names         = nameSize(name());
+  usage.controlBlocks = controlBlockSize;
+
+  std::stack<const IFileTree*> stack;
+  stack.push(this);
+  while (!stack.empty()) {
+    auto tree = stack.top();
+    stack.pop();
+
+    // Do not populate the tree just to measure it:
+    if (!tree->m_Populated) {
+      continue;
+    }
+
+    usage.children +=
+        tree->m_Entries.capacity() * sizeof(std::shared_ptr<FileTreeEntry>);
+
+    for (auto& entry : tree->m_Entries) {
+      usage.names += nameSize(entry->name());
+      usage.controlBlocks += controlBlockSize;
+
+      if (entry->isDir()) {
+        ++usage.directories;
+        usage.nodes += sizeof(IFileTree);
+        stack.push(entry->astree().get());
+      } else {
+        ++usage.files;
+        usage.nodes += sizeof(FileTreeEntry);
+      }
+    }
+  }
+
+  return usage;
+}
+
+/**
+ *
+ */
+IFileTree::PruneCounts IFileTree::pruneRecursive(
+    std::function<bool(std::shared_ptr<FileTreeEntry> const&)> predicate,
+    bool pruneEmptyDirs)
+{
+  PruneCounts counts;
+  pruneRecursive(predicate, pruneEmptyDirs, counts);
+  return counts;
+}
+
+void IFileTree::pruneRecursive(
+    std::function<bool(std::shared_ptr<FileTreeEntry> const&)> const& predicate,
+    bool pruneEmptyDirs, PruneCounts& counts)
+{
+  // Manual remove_if since subtrees must be pruned before checking if they are
+  // empty - kept entries are compacted to the front and the tail erased once:
+  auto& en = entries();
+  auto out = en.begin();
+  for (auto it = en.begin(); it != en.end(); ++it) {
+    auto& entry = *it;
+
+    bool remove = predicate(entry);
+    if (!remove && entry->isDir()) {
+      auto tree = entry->astree();
+      tree->pruneRecursive(predicate, pruneEmptyDirs, counts);
+      remove = pruneEmptyDirs && tree->empty();
+    }
+
+    if (remove && beforeRemove(this, entry.get())) {
+      if (entry->isDir()) {
+        ++counts.directories;
+      } else {
+        ++counts.files;
+      }
+      entry->m_Parent.reset();
+    } else {
+      if (out != it) {
+        *out = std::move(entry);
+      }
+      ++out;
+    }
+  }
+  en.erase(out, en.end());
+}
+
 /**
  *
  */
@@ -560,8 +962,6 @@ std::size_t IFileTree::mergeTree(std::shared_ptr<IFileTree> destination,
   // cannot be assigned to.
   auto &dstEntries = destination->entries(), &srcEntries = source->entries();
 
-  // Note: Since entries are not sorted by name but by type (file/directory)
-  // then name, there is no fast way to check for conflict.
   for (auto& srcEntry : srcEntries) {
 
     // Try to find an exact match (name and type) - This iterator also
@@ -600,12 +1000,11 @@ std::size_t IFileTree::mergeTree(std::shared_ptr<IFileTree> destination,
         return MERGE_FAILED;
       }
     } else {
-      // If we did not find a match, the only way to check is to look
-      // through the vector:
-      auto conflictIt = std::find_if(dstEntries.begin(), dstEntries.end(),
-                                     [name = srcEntry->name()](auto const& dstEntry) {
-                                       return dstEntry->compare(name) == 0;
-                                     });
+      // If we did not find a match, the only possible conflict is an entry with
+      // the same name but of the other type:
+      auto conflictIt =
+          findEntry(dstEntries.begin(), dstEntries.end(), srcEntry->name(),
+                    srcEntry->isDir() ? FileTreeEntry::FILE : FileTreeEntry::DIRECTORY);
 
       // Conflict (note that here both entries are of different types, so no need to
       // check if we replace or merge):
@@ -701,11 +1100,12 @@ std::shared_ptr<const FileTreeEntry> IFileTree::fetchEntry(QStringList const& pa
       tree = tree->parent().get();
     } else {
       // Find the entry at the current level:
-      auto entryIt = std::find_if(tree->begin(), tree->end(),
-                                  MatchEntryComparator{*it, IFileTree::DIRECTORY});
+      auto const& treeEntries = tree->entries();
+      auto entryIt = findEntry(treeEntries.begin(), treeEntries.end(), *it,
+                               IFileTree::DIRECTORY);
 
       // Early exists if the entry does not exist or is not a directory:
-      if (entryIt == tree->end()) {
+      if (entryIt == treeEntries.end()) {
         tree = nullptr;
       } else {
         tree = (*entryIt)->astree().get();
@@ -718,10 +1118,9 @@ std::shared_ptr<const FileTreeEntry> IFileTree::fetchEntry(QStringList const& pa
   }
 
   // We have the final tree:
-  auto entryIt =
-      std::find_if(tree->begin(), tree->end(), MatchEntryComparator{*it, matchTypes});
-  auto bIt = tree->end();
-  return entryIt == bIt ? nullptr : *entryIt;
+  auto const& treeEntries = tree->entries();
+  auto entryIt = findEntry(treeEntries.begin(), treeEntries.end(), *it, matchTypes);
+  return entryIt == treeEntries.end() ? nullptr : *entryIt;
 }
 
 /**
@@ -786,8 +1185,7 @@ std::shared_ptr<IFileTree> IFileTree::createTree(QStringList::const_iterator beg
       // Check if the entry exists (looking for both files and directories
       // because we don't want to override a file):
       auto entryIt =
-          std::find_if(tree->begin(), tree->end(),
-                       MatchEntryComparator{*it, IFileTree::FILE_OR_DIRECTORY});
+          findEntry(tree->begin(), tree->end(), *it, IFileTree::FILE_OR_DIRECTORY);
 
       // Create if it does not:
       if (entryIt == tree->end()) {
@@ -817,6 +1215,37 @@ std::shared_ptr<IFileTree> IFileTree::createTree(QStringList::const_iterator beg
   return tree;
 }
 
+/**
+ *
+ */
+void IFileTree::renameEntry(std::shared_ptr<FileTreeEntry> const& entry, QString name)
+{
+  auto parent = entry->parent();
+  if (parent == nullptr) {
+    entry->m_Name = internString(name);
+    return;
+  }
+
+  // Find the entry before renaming it, while it is still at its sorted position:
+  auto& parentEntries = parent->entries();
+  auto it = findEntry(parentEntries.begin(), parentEntries.end(), entry);
+
+  entry->m_Name = internString(name);
+
+  if (it == parentEntries.end()) {
+    return;
+  }
+
+  // Rotate the entry to its new position, only shifting the entries in-between:
+  const auto comp = FileEntryComparator{};
+  if (it != parentEntries.begin() && comp(entry, *(it - 1))) {
+    std::rotate(std::upper_bound(parentEntries.begin(), it, entry, comp), it, it + 1);
+  } else if (it + 1 != parentEntries.end() && comp(*(it + 1), entry)) {
+    std::rotate(it, it + 1,
+                std::lower_bound(it + 1, parentEntries.end(), entry, comp));
+  }
+}
+
 /**
  * @brief Retrieve the vector of entries after populating it if required.
  *
@@ -845,13 +1274,308 @@ void IFileTree::populate() const
   // Need to check m_Populated again here since the tree can be populated without
   // a call to entries() (e.g., on copy/orphanTree):
   if (!m_Populated) {
-    if (!doPopulate(astree(), m_Entries)) {
+    // lookups rely on the order, so a vector claimed to be sorted is still checked,
+    // which is linear and much cheaper than failing lookups
+    const bool sorted = doPopulate(astree(), m_Entries);
+    if (!sorted || !std::is_sorted(std::begin(m_Entries), std::end(m_Entries),
+                                   FileEntryComparator{})) {
       std::sort(std::begin(m_Entries), std::end(m_Entries), FileEntryComparator{});
     }
+
+    // Most directories are never modified after being populated, so drop the slack
+    // left by push_back when it is large - shrinking reallocates and moves the whole
+    // vector, which is not worth it for the usual growth slack:
+    if (m_Entries.capacity() > 2 * m_Entries.size()) {
+      m_Entries.shrink_to_fit();
+    }
     m_Populated = true;
   }
 }
 
+// TreeEditBatch
+
+TreeEditBatch::TreeEditBatch(std::shared_ptr<IFileTree> root) : m_Root(std::move(root))
+{}
+
+void TreeEditBatch::move(std::shared_ptr<FileTreeEntry> entry, QString path)
+{
+  const bool intoFolder = path.isEmpty() || path.endsWith("/") || path.endsWith("\\");
+
+  QStringList directory = IFileTree::splitPath(path);
+  QString name          = entry->name();
+  if (!intoFolder && !directory.isEmpty()) {
+    name = directory.takeLast();
+  }
+
+  m_Operations.push_back({Operation::Type::Move, std::move(entry),
+                          std::move(directory), std::move(name)});
+}
+
+void TreeEditBatch::rename(std::shared_ptr<FileTreeEntry> entry, QString name)
+{
+  m_Operations.push_back(
+      {Operation::Type::Rename, std::move(entry), {}, std::move(name)});
+}
+
+void TreeEditBatch::remove(std::shared_ptr<FileTreeEntry> entry)
+{
+  m_Operations.push_back({Operation::Type::Remove, std::move(entry), {}, {}});
+}
+
+bool TreeEditBatch::apply()
+{
+  // the batch is consumed whatever the outcome
+  const auto operations = std::exchange(m_Operations, {});
+
+  if (m_Root == nullptr) {
+    return operations.empty();
+  }
+
+  const auto isValidName = [](QString const& name) {
+    return !name.isEmpty() && name != "." && name != ".." && !name.contains('/') &&
+           !name.contains('\\');
+  };
+
+  // 1. check the entries themselves
+  std::unordered_set<const FileTreeEntry*> leaving, removed;
+  for (const auto& op : operations) {
+    if (op.entry == nullptr || !leaving.insert(op.entry.get()).second) {
+      return false;
+    }
+
+    bool underRoot = false;
+    for (auto p = op.entry->parent(); p != nullptr && !underRoot; p = p->parent()) {
+      underRoot = p == m_Root;
+    }
+    if (!underRoot) {
+      return false;
+    }
+
+    if (op.type == Operation::Type::Remove) {
+      removed.insert(op.entry.get());
+    } else if (!isValidName(op.name) ||
+               !std::ranges::all_of(op.directory, isValidName)) {
+      return false;
+    }
+  }
+
+  // 2. resolve the destination directories and check for conflicts - destinations are
+  // identified by their path from the root, and the incoming map contains the entries
+  // that will be added to each of them (null for directories created by the batch)
+  struct Destination
+  {
+    QStringList path;
+    std::shared_ptr<IFileTree> tree;
+
+    // deepest existing directory and index of the first missing part of the path if
+    // the directory does not exist yet
+    std::shared_ptr<IFileTree> existing;
+    qsizetype missing = -1;
+
+    FileNameMap<const FileTreeEntry*> incoming;
+  };
+  std::map<QString, Destination, FileNameComparator> destinations;
+
+  const auto addIncoming = [](Destination& destination, QString const& name,
+                              const FileTreeEntry* entry) {
+    auto [it, inserted] = destination.incoming.emplace(name, entry);
+    return inserted || (it->second == nullptr && entry == nullptr);
+  };
+
+  const auto resolve = [&](QStringList const& path) -> Destination* {
+    auto [it, inserted] = destinations.try_emplace(path.join("/"));
+    auto& destination   = it->second;
+    if (!inserted) {
+      return &destination;
+    }
+
+    destination.path = path;
+
+    std::shared_ptr<IFileTree> tree = m_Root;
+    qsizetype i                     = 0;
+    for (; i < path.size(); ++i) {
+      auto child = tree->find(path[i]);
+      if (child == nullptr) {
+        break;
+      }
+      if (child->isFile() || removed.contains(child.get())) {
+        return nullptr;
+      }
+      tree = child->astree();
+    }
+
+    if (i == path.size()) {
+      destination.tree = tree;
+      return &destination;
+    }
+
+    // each missing directory is an incoming entry of its parent - the parent of the
+    // first one exists, the others will be created
+    destination.existing = tree;
+    destination.missing  = i;
+
+    for (qsizetype j = i; j < path.size(); ++j) {
+      auto& parent = destinations[path.mid(0, j).join("/")];
+      if (parent.path.isEmpty() && j > 0) {
+        parent.path = path.mid(0, j);
+      }
+      if (j == i) {
+        parent.tree = tree;
+      } else {
+        parent.existing = tree;
+        parent.missing  = i;
+      }
+
+      if (!addIncoming(parent, path[j], nullptr)) {
+        return nullptr;
+      }
+    }
+
+    return &destination;
+  };
+
+  std::vector<Destination*> targets(operations.size(), nullptr);
+  for (std::size_t i = 0; i < operations.size(); ++i) {
+    const auto& op = operations[i];
+    if (op.type == Operation::Type::Remove) {
+      continue;
+    }
+
+    auto parent = op.entry->parent();
+    auto destination =
+        resolve(op.type == Operation::Type::Rename
+                    ? IFileTree::splitPath(parent->pathFrom(m_Root, "/"))
+                    : op.directory);
+    if (destination == nullptr) {
+      return false;
+    }
+
+    // conflict with an existing entry that stays in place
+    if (destination->tree != nullptr) {
+      auto existing = destination->tree->find(op.name);
+      if (existing != nullptr && !leaving.contains(existing.get())) {
+        return false;
+      }
+    }
+
+    // conflict with another entry of the batch
+    if (!addIncoming(*destination, op.name, op.entry.get())) {
+      return false;
+    }
+
+    targets[i] = destination;
+  }
+
+  // check that no directory ends up inside itself once all the operations are applied,
+  // e.g., a into b/ and b into a/, looking at the final parent of each moved entry
+  std::unordered_map<const FileTreeEntry*, std::shared_ptr<const IFileTree>> parents;
+  for (std::size_t i = 0; i < operations.size(); ++i) {
+    if (targets[i] != nullptr) {
+      parents[operations[i].entry.get()] =
+          targets[i]->tree ? targets[i]->tree : targets[i]->existing;
+    }
+  }
+  for (const auto& [entry, parent] : parents) {
+    std::unordered_set<const FileTreeEntry*> visited;
+    for (auto tree = parent; tree != nullptr;) {
+      if (tree.get() == entry || !visited.insert(tree.get()).second) {
+        return false;
+      }
+      auto it = parents.find(tree.get());
+      tree    = it != parents.end() ? it->second : tree->parent();
+    }
+  }
+
+  // 3. create the missing directories, removing them if anything fails
+  std::vector<std::pair<std::shared_ptr<IFileTree>, QString>> created;
+  const auto rollback = [&created] {
+    for (auto& [tree, name] : created | std::views::reverse) {
+      auto& treeEntries = tree->entries();
+      auto it = findEntry(treeEntries.begin(), treeEntries.end(), name,
+                          FileTreeEntry::DIRECTORY);
+      if (it != treeEntries.end()) {
+        (*it)->m_Parent.reset();
+        treeEntries.erase(it);
+      }
+    }
+    return false;
+  };
+
+  for (auto& [key, destination] : destinations) {
+    if (destination.tree != nullptr) {
+      continue;
+    }
+
+    if (!destination.existing->exists(destination.path[destination.missing],
+                                      FileTreeEntry::DIRECTORY)) {
+      created.emplace_back(destination.existing,
+                           destination.path[destination.missing]);
+    }
+
+    destination.tree =
+        m_Root->createTree(destination.path.cbegin(), destination.path.cend());
+    if (destination.tree == nullptr) {
+      return rollback();
+    }
+  }
+
+  // 4. call the hooks, nothing has been modified yet except created directories - like
+  // IFileTree::move(), entries renamed in place do not go through the hooks
+  for (std::size_t i = 0; i < operations.size(); ++i) {
+    const auto& op = operations[i];
+    auto parent    = op.entry->parent();
+
+    if (op.type == Operation::Type::Remove) {
+      if (!parent->beforeRemove(parent.get(), op.entry.get())) {
+        return rollback();
+      }
+    } else if (targets[i]->tree != parent) {
+      auto tree = targets[i]->tree;
+      if (!tree->beforeInsert(tree.get(), op.entry.get()) ||
+          !parent->beforeRemove(parent.get(), op.entry.get())) {
+        return rollback();
+      }
+    }
+  }
+
+  // 5. apply - detach all the entries with one pass per source directory, then append
+  // to the destination directories and sort the appended entries once per directory
+  std::set<std::shared_ptr<IFileTree>> sources;
+  for (const auto& op : operations) {
+    sources.insert(op.entry->parent());
+  }
+  for (const auto& source : sources) {
+    source->detachAll(leaving);
+  }
+
+  std::map<IFileTree*, std::size_t> sizes;
+  for (std::size_t i = 0; i < operations.size(); ++i) {
+    const auto& op = operations[i];
+
+    if (op.type == Operation::Type::Remove) {
+      continue;
+    }
+
+    auto tree         = targets[i]->tree;
+    auto& treeEntries = tree->entries();
+    sizes.try_emplace(tree.get(), treeEntries.size());
+
+    op.entry->m_Name   = internString(op.name);
+    op.entry->m_Parent = tree;
+    treeEntries.push_back(op.entry);
+  }
+
+  for (auto& [tree, size] : sizes) {
+    auto& treeEntries = tree->entries();
+    const auto middle = treeEntries.begin() + static_cast<std::ptrdiff_t>(size);
+    std::sort(middle, treeEntries.end(), FileEntryComparator{});
+    std::inplace_merge(treeEntries.begin(), middle, treeEntries.end(),
+                       FileEntryComparator{});
+  }
+
+  return true;
+}
+
 // walk and glob with generator
 
 std::generator<std::shared_ptr<const FileTreeEntry>>
@@ -1,14 +1,25 @@
 #include "log.h"
+#include "flightrecorder.h"
 #include "pch.h"
 #include "utility.h"
 #include <iostream>
 
 #include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <cwctype>
+#include <fstream>
 #include <locale>
+#include <map>
+#include <thread>
 
 #pragma warning(push)
 #pragma warning(disable : 4365)
 #define SPDLOG_WCHAR_FILENAMES 1
+#include <spdlog/async_logger.h>
+#include <spdlog/details/periodic_worker.h>
+#include <spdlog/details/thread_pool.h>
 #include <spdlog/logger.h>
 #include <spdlog/sinks/base_sink.h>
 #include <spdlog/sinks/basic_file_sink.h>
@@ -18,6 +29,205 @@
 #include <spdlog/sinks/stdout_color_sinks.h>
 #pragma warning(pop)
 
+namespace MOBase::log::details
+{
+
+// Aho-Corasick automaton over the filters of a blacklist, with a complete transition
+// table so that matching is a single table lookup per byte
+//
+// bytes are folded to ASCII upper case and mapped to classes, class 0 being shared by
+// all the bytes that do not appear in any filter, which keeps the table small
+//
+class Blacklist
+{
+public:
+  explicit Blacklist(std::vector<BlacklistEntry> entries);
+
+  // replaces the leftmost-longest non-overlapping matches in a single pass,
+  // replacements are not scanned again
+  //
+  void apply(std::string& s) const;
+
+private:
+  std::vector<BlacklistEntry> m_entries;
+
+  std::array<std::uint16_t, 256> m_classes{};
+  std::size_t m_classCount = 1;
+
+  // m_classCount transitions per state, state 0 is the root
+  std::vector<std::uint32_t> m_transitions;
+
+  // per state: depth in the trie, and length and entry of the longest filter
+  // ending in this state (length is 0 if none)
+  std::vector<std::uint32_t> m_depth;
+  std::vector<std::uint32_t> m_matchLength;
+  std::vector<std::uint32_t> m_matchEntry;
+
+  std::uint32_t next(std::uint32_t state, char c) const
+  {
+    return m_transitions[state * m_classCount +
+                         m_classes[static_cast<unsigned char>(c)]];
+  }
+};
+
+// per call site counters in a fixed-size open addressing table, and the hash
+// of the last message; everything is atomic so checks never lock, at the cost
+// of being approximate when several threads log from the same call site
+//
+class Throttle
+{
+public:
+  Throttle(std::size_t limit, std::chrono::milliseconds interval, bool coalesce)
+      : m_limit(limit), m_interval(std::max(interval, std::chrono::milliseconds(1))),
+        m_coalesce(coalesce)
+  {}
+
+  // key of a call site identified by the address of its format string
+  //
+  static std::uint64_t site(const char* format) noexcept
+  {
+    return reinterpret_cast<std::uintptr_t>(format);
+  }
+
+  // key of a call site identified by its location; the top bit is never set
+  // in user space addresses on the supported platforms, so these keys cannot
+  // collide with the ones above
+  //
+  static std::uint64_t site(const std::source_location& loc) noexcept
+  {
+    auto h = reinterpret_cast<std::uintptr_t>(loc.file_name()) * 0x9e3779b97f4a7c15ull;
+    h ^= ((std::uint64_t{loc.line()} << 32) | loc.column()) + (h << 6) + (h >> 2);
+    return h | (std::uint64_t{1} << 63);
+  }
+
+  // whether a message from the given call site can be logged; when a new
+  // interval starts, `suppressed` is set to the number of messages dropped from
+  // this call site during the previous ones
+  //
+  bool allow(std::uint64_t site, std::uint64_t& suppressed) noexcept
+  {
+    if (m_limit == 0) {
+      return true;
+    }
+
+    auto* s = find(site);
+    if (!s) {
+      // table is full
+      return true;
+    }
+
+    const auto window = static_cast<std::uint64_t>(
+        std::chrono::steady_clock::now().time_since_epoch() / m_interval);
+
+    auto current = s->window.load(std::memory_order_relaxed);
+    if (current != window &&
+        s->window.compare_exchange_strong(current, window, std::memory_order_relaxed)) {
+      s->count.store(0, std::memory_order_relaxed);
+      suppressed = s->dropped.exchange(0, std::memory_order_relaxed);
+    }
+
+    if (s->count.fetch_add(1, std::memory_order_relaxed) < m_limit) {
+      return true;
+    }
+
+    s->dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // whether the message is the same as the previous one; if not, `repeats` and
+  // `repeatLevel` are set to the number of times the previous one was dropped
+  // and its level
+  //
+  bool repeated(Levels lv, std::string_view message, std::uint64_t& repeats,
+                Levels& repeatLevel) noexcept
+  {
+    if (!m_coalesce) {
+      return false;
+    }
+
+    const auto hash = std::hash<std::string_view>()(message) ^
+                      (static_cast<std::size_t>(lv) + 1) * 0x9e3779b97f4a7c15ull;
+
+    if (m_last.exchange(hash, std::memory_order_relaxed) == hash) {
+      m_repeats.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+
+    repeatLevel = m_lastLevel.exchange(lv, std::memory_order_relaxed);
+    repeats     = m_repeats.exchange(0, std::memory_order_relaxed);
+    return false;
+  }
+
+  // returns and resets the number of messages dropped by the rate limit since
+  // the last time they were reported
+  //
+  std::uint64_t takeSuppressed() noexcept
+  {
+    std::uint64_t n = 0;
+    for (auto& s : m_sites) {
+      n += s.dropped.exchange(0, std::memory_order_relaxed);
+    }
+
+    return n;
+  }
+
+  // returns and resets the number of times the last message was repeated
+  //
+  std::uint64_t takeRepeats(Levels& lv) noexcept
+  {
+    lv = m_lastLevel.load(std::memory_order_relaxed);
+    return m_repeats.exchange(0, std::memory_order_relaxed);
+  }
+
+private:
+  static constexpr std::size_t SiteCount = 1024;
+  static constexpr std::size_t MaxProbes = 16;
+
+  struct Site
+  {
+    // see site(), 0 if unused; never removed
+    std::atomic<std::uint64_t> key{0};
+
+    std::atomic<std::uint64_t> window{0};
+    std::atomic<std::uint64_t> count{0};
+    std::atomic<std::uint64_t> dropped{0};
+  };
+
+  std::size_t m_limit;
+  std::chrono::milliseconds m_interval;
+  bool m_coalesce;
+
+  std::array<Site, SiteCount> m_sites;
+
+  std::atomic<std::size_t> m_last{0};
+  std::atomic<Levels> m_lastLevel{Info};
+  std::atomic<std::uint64_t> m_repeats{0};
+
+  Site* find(std::uint64_t site) noexcept
+  {
+    const auto hash = static_cast<std::size_t>((site >> 3) * 0x9e3779b97f4a7c15ull);
+
+    for (std::size_t i = 0; i < MaxProbes; ++i) {
+      auto& s  = m_sites[(hash + i) & (SiteCount - 1)];
+      auto key = s.key.load(std::memory_order_relaxed);
+
+      if (key == 0 &&
+          s.key.compare_exchange_strong(key, site, std::memory_order_relaxed)) {
+        return &s;
+      }
+
+      // key is the current one if the exchange failed
+      if (key == site) {
+        return &s;
+      }
+    }
+
+    return nullptr;
+  }
+};
+
+}  // namespace MOBase::log::details
+
 namespace MOBase::log
 {
 
@@ -64,190 +274,1378 @@ Levels fromSpdlog(spdlog::level::level_enum lv)
   }
 }
 
+// formats each line of a message with the pattern, so that multi-line messages
+// go through the logger as a single message: the dist_sink is locked once,
+// file sinks get all the lines in a single write and are flushed once
+//
+class MultilineFormatter : public spdlog::formatter
+{
+public:
+  MultilineFormatter(std::unique_ptr<spdlog::formatter> f) : m_f(std::move(f)) {}
+
+  void format(const spdlog::details::log_msg& m, spdlog::memory_buf_t& dest) override
+  {
+    const std::string_view payload(m.payload.data(), m.payload.size());
+
+    if (payload.find('\n') == std::string_view::npos) {
+      m_f->format(m, dest);
+      return;
+    }
+
+    auto line         = m;
+    std::size_t start = 0;
+
+    for (;;) {
+      const auto nl = payload.find('\n', start);
+      const auto end = (nl == std::string_view::npos ? payload.size() : nl);
+
+      line.payload = spdlog::string_view_t(payload.data() + start, end - start);
+      m_f->format(line, dest);
+
+      if (start == 0) {
+        // colors of the first line, used by the console sink
+        m.color_range_start = line.color_range_start;
+        m.color_range_end   = line.color_range_end;
+      }
+
+      if (nl == std::string_view::npos) {
+        break;
+      }
+
+      start = nl + 1;
+    }
+  }
+
+  std::unique_ptr<spdlog::formatter> clone() const override
+  {
+    return std::make_unique<MultilineFormatter>(m_f->clone());
+  }
+
+private:
+  std::unique_ptr<spdlog::formatter> m_f;
+};
+
+std::unique_ptr<spdlog::formatter> createFormatter(const std::string& pattern, bool utc)
+{
+  const auto timeType =
+      utc ? spdlog::pattern_time_type::utc : spdlog::pattern_time_type::local;
+
+  return std::make_unique<MultilineFormatter>(
+      std::make_unique<spdlog::pattern_formatter>(pattern, timeType));
+}
+
+// formats each line of a message separately into `buf` and calls `f` with a
+// view of the line, valid until the next one
+//
+template <class F>
+void forEachLine(const spdlog::details::log_msg& m, spdlog::formatter& formatter,
+                 spdlog::memory_buf_t& buf, F&& f)
+{
+  const std::string_view payload(m.payload.data(), m.payload.size());
+  auto line         = m;
+  std::size_t start = 0;
+
+  for (;;) {
+    const auto nl  = payload.find('\n', start);
+    const auto end = (nl == std::string_view::npos ? payload.size() : nl);
+
+    line.payload = spdlog::string_view_t(payload.data() + start, end - start);
+
+    buf.clear();
+    formatter.format(line, buf);
+
+    // remove \r\n
+    std::string_view formatted(buf.data(), buf.size());
+    while (!formatted.empty() &&
+           (formatted.back() == '\n' || formatted.back() == '\r')) {
+      formatted.remove_suffix(1);
+    }
+
+    f(EntryView{.time             = m.time,
+                .level            = fromSpdlog(m.level),
+                .message          = payload.substr(start, end - start),
+                .formattedMessage = formatted});
+
+    if (nl == std::string_view::npos) {
+      break;
+    }
+
+    start = nl + 1;
+  }
+}
+
 class CallbackSink : public spdlog::sinks::base_sink<std::mutex>
 {
 public:
-  CallbackSink(Callback* f) : m_f(f) {}
+  CallbackSink() = default;
+
+  void setCallback(Callback* f) { m_f = f; }
+  void setViewCallback(ViewCallback* f) { m_view = f; }
+
+protected:
+  void sink_it_(const spdlog::details::log_msg& m) override
+  {
+    thread_local bool active = false;
+
+    if (active) {
+      // trying to log from a log callback, ignoring
+      return;
+    }
+
+    auto* f    = m_f.load();
+    auto* view = m_view.load();
+
+    if (!f && !view) {
+      // disabled
+      return;
+    }
+
+    try {
+      auto g = Guard([&] {
+        active = false;
+      });
+      active = true;
+
+      // one entry per line
+      forEachLine(m, *base_sink::formatter_, m_formatted, [&](const EntryView& e) {
+        if (view) {
+          (*view)(e);
+        }
+
+        if (f) {
+          (*f)(Entry{.time             = e.time,
+                     .level            = e.level,
+                     .message          = std::string(e.message),
+                     .formattedMessage = std::string(e.formattedMessage)});
+        }
+      });
+    } catch (std::exception& e) {
+      fprintf(stderr, "uncaugh exception in logging callback, %s\n", e.what());
+    } catch (...) {
+      fprintf(stderr, "uncaught exception in logging callback\n");
+    }
+  }
+
+  void flush_() override
+  {
+    // no-op
+  }
+
+private:
+  std::atomic<Callback*> m_f{nullptr};
+  std::atomic<ViewCallback*> m_view{nullptr};
+
+  // reused for each line
+  spdlog::memory_buf_t m_formatted;
+};
+
+// accumulates the lines in a single buffer and hands them to the callback on a
+// background thread; logging only appends to the buffer, the callback is
+// called without holding its lock
+//
+class BatchCallbackSink : public spdlog::sinks::sink
+{
+public:
+  BatchCallbackSink(BatchCallback* f, std::chrono::milliseconds interval)
+      : m_f(f), m_formatter(std::make_unique<spdlog::pattern_formatter>())
+  {
+    m_worker = std::make_unique<spdlog::details::periodic_worker>(
+        [this] {
+          deliver();
+        },
+        std::max(interval, std::chrono::milliseconds(1)));
+  }
+
+  ~BatchCallbackSink() override
+  {
+    // joins the thread before anything else is destroyed
+    m_worker.reset();
+  }
+
+  void log(const spdlog::details::log_msg& m) override
+  {
+    if (t_delivering) {
+      // trying to log from the callback, ignoring
+      return;
+    }
+
+    std::scoped_lock lock(m_mutex);
+
+    forEachLine(m, *m_formatter, m_formatted, [&](const EntryView& e) {
+      auto& text = m_pending.text;
+
+      m_pending.lines.push_back({.time          = e.time,
+                                 .level         = e.level,
+                                 .message       = text.size(),
+                                 .messageSize   = e.message.size(),
+                                 .formatted     = text.size() + e.message.size(),
+                                 .formattedSize = e.formattedMessage.size()});
+
+      text.append(e.message);
+      text.append(e.formattedMessage);
+    });
+  }
+
+  // spdlog flushes the sinks while holding the lock of the dist_sink, which
+  // would block every logging thread for as long as the callback runs; lines
+  // are delivered by the worker, Logger::flush() and setBatchCallback() instead
+  //
+  void flush() override {}
+
+  // hands the pending lines to the callback on the calling thread, must not be
+  // called while holding the lock of the dist_sink
+  //
+  void deliver()
+  {
+    std::scoped_lock deliverLock(m_deliverMutex);
+
+    {
+      std::scoped_lock lock(m_mutex);
+      std::swap(m_pending, m_delivering);
+    }
+
+    if (m_delivering.lines.empty()) {
+      return;
+    }
+
+    if (auto* f = m_f.load()) {
+      const std::string_view text = m_delivering.text;
+
+      m_views.clear();
+      for (const auto& line : m_delivering.lines) {
+        m_views.push_back(
+            {.time             = line.time,
+             .level            = line.level,
+             .message          = text.substr(line.message, line.messageSize),
+             .formattedMessage = text.substr(line.formatted, line.formattedSize)});
+      }
+
+      try {
+        auto g = Guard([&] {
+          t_delivering = false;
+        });
+        t_delivering = true;
+
+        (*f)(std::span<const EntryView>(m_views));
+      } catch (std::exception& e) {
+        fprintf(stderr, "uncaugh exception in logging callback, %s\n", e.what());
+      } catch (...) {
+        fprintf(stderr, "uncaught exception in logging callback\n");
+      }
+    }
+
+    m_delivering.text.clear();
+    m_delivering.lines.clear();
+  }
+
+  void set_pattern(const std::string& pattern) override
+  {
+    set_formatter(std::make_unique<spdlog::pattern_formatter>(pattern));
+  }
+
+  void set_formatter(std::unique_ptr<spdlog::formatter> f) override
+  {
+    std::scoped_lock lock(m_mutex);
+    m_formatter = std::move(f);
+  }
+
+private:
+  // lines logged since the last delivery, their text is kept in a single
+  // buffer so nothing is allocated once it has grown
+  //
+  struct Batch
+  {
+    struct Line
+    {
+      std::chrono::system_clock::time_point time;
+      Levels level;
+      std::size_t message, messageSize;
+      std::size_t formatted, formattedSize;
+    };
+
+    std::string text;
+    std::vector<Line> lines;
+  };
+
+  static thread_local bool t_delivering;
+
+  std::atomic<BatchCallback*> m_f;
+
+  // protects the formatter and the pending batch
+  std::mutex m_mutex;
+  std::unique_ptr<spdlog::formatter> m_formatter;
+  spdlog::memory_buf_t m_formatted;
+  Batch m_pending;
+
+  // used by deliver() only, swapped with m_pending
+  std::mutex m_deliverMutex;
+  Batch m_delivering;
+  std::vector<EntryView> m_views;
+
+  std::unique_ptr<spdlog::details::periodic_worker> m_worker;
+};
+
+thread_local bool BatchCallbackSink::t_delivering = false;
+
+// the sinks of a logger; in async mode, Logger::flush() posts a marker message
+// through the queue and waits until it comes out, at which point everything
+// logged before it has been written
+//
+class LoggerSinks : public spdlog::sinks::dist_sink<std::mutex>
+{
+public:
+  // logs a marker with the given logger and returns its ticket, see wait()
+  //
+  int postFlush(spdlog::logger& lg)
+  {
+    const int ticket = ++m_posted;
+    lg.log(spdlog::source_loc{FlushMarker, ticket, ""}, spdlog::level::critical,
+           spdlog::string_view_t());
+
+    return ticket;
+  }
+
+  // waits until the marker with the given ticket has been handled, or until
+  // the timeout expires, in case it was dropped from a full queue
+  //
+  bool wait(int ticket, std::chrono::milliseconds timeout)
+  {
+    std::unique_lock lock(m_flushMutex);
+    return m_flushed.wait_for(lock, timeout, [&] {
+      return m_handled >= ticket;
+    });
+  }
+
+protected:
+  void sink_it_(const spdlog::details::log_msg& m) override
+  {
+    if (m.source.filename != FlushMarker) {
+      dist_sink::sink_it_(m);
+      return;
+    }
+
+    dist_sink::flush_();
+
+    {
+      std::scoped_lock lock(m_flushMutex);
+      m_handled = std::max(m_handled, m.source.line);
+    }
+
+    m_flushed.notify_all();
+  }
+
+private:
+  // only its address is used, async messages keep the source location as-is
+  static constexpr char FlushMarker[] = "uibase-flush-marker";
+
+  std::atomic<int> m_posted{0};
+
+  std::mutex m_flushMutex;
+  std::condition_variable m_flushed;
+  int m_handled = 0;
+};
+
+// how long Logger::flush() waits for the queue in async mode
+constexpr auto AsyncFlushTimeout = std::chrono::seconds(5);
+
+File::File() : type(None), maxSize(0), maxFiles(0), dailyHour(0), dailyMinute(0) {}
+
+File File::daily(fs::path file, int hour, int minute)
+{
+  File fl;
+
+  fl.type        = Daily;
+  fl.file        = std::move(file);
+  fl.dailyHour   = hour;
+  fl.dailyMinute = minute;
+
+  return fl;
+}
+
+File File::rotating(fs::path file, std::size_t maxSize, std::size_t maxFiles)
+{
+  File fl;
+
+  fl.type     = Rotating;
+  fl.file     = std::move(file);
+  fl.maxSize  = maxSize;
+  fl.maxFiles = maxFiles;
+
+  return fl;
+}
+
+File File::single(std::filesystem::path file)
+{
+  File fl;
+
+  fl.type = Single;
+  fl.file = std::move(file);
+
+  return fl;
+}
+
+namespace details
+{
+
+// gzip checksum
+//
+static std::uint32_t crc32(const char* data, std::size_t size)
+{
+  static const auto table = [] {
+    std::array<std::uint32_t, 256> t{};
+
+    for (std::uint32_t i = 0; i < 256; ++i) {
+      std::uint32_t c = i;
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      }
+      t[i] = c;
+    }
+
+    return t;
+  }();
+
+  std::uint32_t crc = 0xffffffffu;
+  for (std::size_t i = 0; i < size; ++i) {
+    crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xff] ^ (crc >> 8);
+  }
+
+  return crc ^ 0xffffffffu;
+}
+
+// whether `name` is `prefix`, followed by something with the given shape,
+// where '9' is any digit and other characters match themselves, followed by
+// `suffix`
+//
+static bool matchesShape(std::wstring_view name, std::wstring_view prefix,
+                         std::wstring_view shape, std::wstring_view suffix)
+{
+  if (name.size() != prefix.size() + shape.size() + suffix.size() ||
+      !name.starts_with(prefix) || !name.ends_with(suffix)) {
+    return false;
+  }
+
+  const auto middle = name.substr(prefix.size(), shape.size());
+  for (std::size_t i = 0; i < shape.size(); ++i) {
+    if (shape[i] == L'9' ? !std::iswdigit(middle[i]) : middle[i] != shape[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// compresses the files rotated out by a file sink to gzip on a low priority
+// thread, and removes the oldest compressed files above the retention limit
+//
+// before the sink opens a new file, rotated files are renamed to unique
+// pending names while the sink holds its lock; the thread only works on
+// pending files, so it never races with the sink, and pending files left by a
+// previous run are compressed when the next one starts
+//
+class LogCompressor
+{
+public:
+  LogCompressor(File f, std::uintmax_t maxTotalSize)
+      : m_file(std::move(f)), m_maxTotalSize(maxTotalSize),
+        m_dir(m_file.file.parent_path()), m_stem(m_file.file.stem().native()),
+        m_ext(m_file.file.extension().native())
+  {
+    m_thread = std::thread([this] {
+      run();
+    });
+  }
+
+  ~LogCompressor()
+  {
+    {
+      std::scoped_lock lock(m_mutex);
+      m_stop = true;
+    }
+
+    m_wakeup.notify_all();
+    m_thread.join();
+  }
+
+  // called by the sink before opening a file, under its lock
+  //
+  void beforeOpen(const fs::path& opened) noexcept
+  {
+    try {
+      for (auto& path : rotatedFiles(opened)) {
+        std::error_code ec;
+        fs::rename(path, pendingName(), ec);
+      }
+
+      {
+        std::scoped_lock lock(m_mutex);
+        m_work = true;
+      }
+
+      m_wakeup.notify_all();
+    } catch (...) {
+      // eat it, the files will be picked up on the next rotation
+    }
+  }
+
+private:
+  // shape of the timestamp in pending files, with a counter for files renamed
+  // in the same second
+  static constexpr std::wstring_view PendingShape = L"99999999-999999-999";
+
+  File m_file;
+  std::uintmax_t m_maxTotalSize;
+  fs::path m_dir;
+  std::wstring m_stem, m_ext;
+
+  std::mutex m_mutex;
+  std::condition_variable m_wakeup;
+  bool m_stop = false;
+  bool m_work = true;
+  std::thread m_thread;
+
+  void run()
+  {
+    ::SetThreadPriority(::GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+
+    std::unique_lock lock(m_mutex);
+
+    for (;;) {
+      m_wakeup.wait(lock, [this] {
+        return m_stop || m_work;
+      });
+
+      if (m_stop) {
+        break;
+      }
+
+      m_work = false;
+      lock.unlock();
+
+      try {
+        compressPending();
+        removeOldest();
+      } catch (std::exception& e) {
+        std::cerr << "failed to compress rotated logs, " << e.what() << "\n";
+      }
+
+      lock.lock();
+    }
+  }
+
+  bool stopping()
+  {
+    std::scoped_lock lock(m_mutex);
+    return m_stop;
+  }
+
+  // files rotated out by the sink, or left by a previous run
+  //
+  std::vector<fs::path> rotatedFiles(const fs::path& opened) const
+  {
+    std::vector<fs::path> files;
+
+    if (m_file.type == File::Rotating) {
+      // "name.1.ext", "name.2.ext", etc.; this runs after each rotation, so
+      // there is usually only "name.1.ext"
+      for (std::size_t i = 1; i <= m_file.maxFiles; ++i) {
+        auto path = m_dir / std::format(L"{}.{}{}", m_stem, i, m_ext);
+        if (!fs::exists(path)) {
+          break;
+        }
+
+        files.push_back(std::move(path));
+      }
+    } else if (m_file.type == File::Daily) {
+      // "name_YYYY-MM-DD.ext", except the one being opened
+      const auto prefix = m_stem + L"_";
+
+      for (const auto& entry : fs::directory_iterator(m_dir)) {
+        if (entry.path() != opened &&
+            matchesShape(entry.path().filename().native(), prefix, L"9999-99-99",
+                         m_ext)) {
+          files.push_back(entry.path());
+        }
+      }
+    }
+
+    return files;
+  }
+
+  fs::path pendingName() const
+  {
+    const auto now = std::chrono::floor<std::chrono::seconds>(
+        std::chrono::system_clock::now());
+
+    for (int i = 0;; ++i) {
+      auto path = m_dir / std::format(L"{}-{:%Y%m%d-%H%M%S}-{:03}{}", m_stem, now,
+                                      i % 1000, m_ext);
+
+      if (i >= 999 || (!fs::exists(path) && !fs::exists(path.native() + L".gz"))) {
+        return path;
+      }
+    }
+  }
+
+  // pending or compressed files, sorted from oldest to newest
+  //
+  std::vector<fs::path> find(std::wstring_view suffix) const
+  {
+    std::vector<fs::path> files;
+    const auto prefix = m_stem + L"-";
+    const auto ext    = m_ext + std::wstring(suffix);
+
+    for (const auto& entry : fs::directory_iterator(m_dir)) {
+      if (matchesShape(entry.path().filename().native(), prefix, PendingShape, ext)) {
+        files.push_back(entry.path());
+      }
+    }
+
+    std::sort(files.begin(), files.end());
+    return files;
+  }
+
+  void compressPending()
+  {
+    for (const auto& path : find(L"")) {
+      if (stopping()) {
+        // picked up on the next run
+        return;
+      }
+
+      compress(path);
+    }
+  }
+
+  void compress(const fs::path& path)
+  {
+    QFile in(QString::fromStdWString(path.native()));
+    if (!in.open(QIODevice::ReadOnly)) {
+      std::cerr << "can't open rotated log " << path.string() << "\n";
+      return;
+    }
+
+    const QByteArray data = in.readAll();
+    in.close();
+
+    // qCompress() gives the size as 4 bytes followed by a zlib stream, which
+    // is a 2 bytes header, the deflate data and a 4 bytes checksum; gzip has
+    // the same deflate data with a different header and trailer
+    const QByteArray z = qCompress(data);
+    if (z.size() < 10) {
+      return;
+    }
+
+    const auto put32 = [](std::ofstream& out, std::uint32_t v) {
+      const char bytes[] = {static_cast<char>(v), static_cast<char>(v >> 8),
+                            static_cast<char>(v >> 16), static_cast<char>(v >> 24)};
+      out.write(bytes, 4);
+    };
+
+    const auto gz  = fs::path(path.native() + L".gz");
+    const auto tmp = fs::path(gz.native() + L".tmp");
+
+    {
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+
+      // magic, deflate, no flags, no time, no extra flags, NTFS
+      const char header[] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, 11};
+      out.write(header, sizeof(header));
+      out.write(z.constData() + 6, z.size() - 10);
+      put32(out, crc32(data.constData(), static_cast<std::size_t>(data.size())));
+      put32(out, static_cast<std::uint32_t>(data.size()));
+
+      if (!out) {
+        std::cerr << "failed to write " << tmp.string() << "\n";
+        out.close();
+        fs::remove(tmp);
+        return;
+      }
+    }
+
+    fs::rename(tmp, gz);
+    fs::remove(path);
+  }
+
+  // keeps at most maxFiles compressed files for rotating files, and removes
+  // the oldest ones above m_maxTotalSize if it is set
+  //
+  void removeOldest()
+  {
+    const std::size_t maxFiles = m_file.type == File::Rotating ? m_file.maxFiles : 0;
+
+    if (maxFiles == 0 && m_maxTotalSize == 0) {
+      return;
+    }
+
+    const auto files = find(L".gz");
+
+    std::uintmax_t total = 0;
+    std::vector<std::uintmax_t> sizes;
+
+    for (const auto& path : files) {
+      std::error_code ec;
+      const auto size = fs::file_size(path, ec);
+
+      sizes.push_back(ec ? 0 : size);
+      total += sizes.back();
+    }
+
+    const auto tooMany = [&](std::size_t i) {
+      return maxFiles > 0 && files.size() - i > maxFiles;
+    };
+
+    const auto tooLarge = [&] {
+      return m_maxTotalSize > 0 && total > m_maxTotalSize;
+    };
+
+    for (std::size_t i = 0; i < files.size() && (tooMany(i) || tooLarge()); ++i) {
+      std::error_code ec;
+      if (fs::remove(files[i], ec)) {
+        total -= sizes[i];
+      }
+    }
+  }
+};
+
+}  // namespace details
+
+spdlog::sink_ptr createFileSink(const File& f,
+                                const std::shared_ptr<details::LogCompressor>& c)
+{
+  spdlog::file_event_handlers handlers;
+
+  if (c) {
+    handlers.before_open = [c = std::weak_ptr(c)](const spdlog::filename_t& name) {
+      if (auto compressor = c.lock()) {
+        compressor->beforeOpen(name);
+      }
+    };
+  }
+
+  try {
+    switch (f.type) {
+    case File::Daily: {
+      return std::make_shared<spdlog::sinks::daily_file_sink_mt>(
+          f.file.native(), f.dailyHour, f.dailyMinute, false, std::uint16_t(0),
+          handlers);
+    }
+
+    case File::Rotating: {
+      return std::make_shared<spdlog::sinks::rotating_file_sink_mt>(
+          f.file.native(), f.maxSize, f.maxFiles, false, handlers);
+    }
+
+    case File::Single: {
+      return std::make_shared<spdlog::sinks::basic_file_sink_mt>(f.file.native(), true);
+    }
+
+    case File::None:  // fall-through
+    default:
+      return {};
+    }
+  } catch (spdlog::spdlog_ex& e) {
+    std::cerr << "failed to create file log, " << e.what() << "\n";
+    return {};
+  }
+}
+
+// the spdlog logger of a Logger, which knows its owner so that messages from
+// plugins built against older versions of log.h, which give it directly to
+// details::doLogImpl(), go through the level check
+//
+class OwnedLogger : public spdlog::logger
+{
+public:
+  OwnedLogger(std::string name, spdlog::sink_ptr sink, details::LoggerImpl& owner)
+      : spdlog::logger(std::move(name), std::move(sink)), m_owner(owner)
+  {}
+
+  details::LoggerImpl& owner() const { return m_owner; }
+
+private:
+  details::LoggerImpl& m_owner;
+};
+
+namespace details
+{
+
+// everything a Logger needs on top of its original members, which cannot
+// change since plugins built against older versions of log.h use them
+//
+class LoggerImpl
+{
+public:
+  LoggerImpl(Logger& owner, LoggerOptions options)
+      : m_owner(owner), m_options(std::move(options)),
+        m_level(owner.m_conf.maxLevel), m_formatLevel(owner.m_conf.maxLevel)
+  {
+    if (m_options.rateLimit > 0 || m_options.coalesceDuplicates) {
+      m_throttle = std::make_unique<Throttle>(
+          m_options.rateLimit, m_options.rateInterval, m_options.coalesceDuplicates);
+    }
+  }
+
+  ~LoggerImpl()
+  {
+    m_flusher.reset();
+    flush();
+
+    // the pool only holds weak references from the logger, so this joins the
+    // threads once they have written everything left in the queue
+    m_pool.reset();
+  }
+
+  const LoggerOptions& options() const { return m_options; }
+
+  // the logger messages are written to, the async one if enabled
+  //
+  spdlog::logger& target() const { return m_async ? *m_async : *m_owner.m_logger; }
+
+  // creates the loggers over the given sinks, after the console sink has been
+  // added to them
+  //
+  void createLogger(const std::string& name, spdlog::sink_ptr sinks)
+  {
+    m_owner.m_logger = std::make_unique<OwnedLogger>(name, sinks, *this);
+
+    if (m_options.async) {
+      const auto policy = m_options.overflow == OverflowPolicy::DropOldest
+                              ? spdlog::async_overflow_policy::overrun_oldest
+                              : spdlog::async_overflow_policy::block;
+
+      m_pool = std::make_shared<spdlog::details::thread_pool>(
+          std::max<std::size_t>(m_options.queueSize, 1),
+          std::max<std::size_t>(m_options.threads, 1));
+      m_async = std::make_shared<spdlog::async_logger>(name, sinks, m_pool, policy);
+    }
+
+    // levels are checked by Logger and Category before formatting, the spdlog
+    // loggers let everything through
+    for (spdlog::logger* lg : {m_owner.m_logger.get(),
+                               static_cast<spdlog::logger*>(m_async.get())}) {
+      if (lg) {
+        lg->set_level(spdlog::level::trace);
+        lg->flush_on(toSpdlog(m_options.flushLevel));
+      }
+    }
+
+    if (m_options.flushInterval > std::chrono::milliseconds::zero()) {
+      m_flusher = std::make_unique<spdlog::details::periodic_worker>(
+          [this] {
+            target().flush();
+          },
+          m_options.flushInterval);
+    }
+  }
+
+  Levels level() const { return m_level.load(std::memory_order_relaxed); }
+
+  void setLevel(Levels lv)
+  {
+    m_level.store(lv, std::memory_order_relaxed);
+    updateFormatLevel();
+  }
+
+  bool enabled(Levels lv) const noexcept
+  {
+    return compiledIn(lv) && lv >= m_level.load(std::memory_order_relaxed);
+  }
+
+  bool formatted(Levels lv) const noexcept
+  {
+    return compiledIn(lv) && lv >= m_formatLevel.load(std::memory_order_relaxed);
+  }
+
+  void flush()
+  {
+    try {
+      if (m_throttle) {
+        Levels lv;
+        if (const auto n = m_throttle->takeRepeats(lv); n > 0) {
+          write(lv, std::format("last message repeated {} times", n));
+        }
+
+        if (const auto n = m_throttle->takeSuppressed(); n > 0) {
+          write(Warning,
+                std::format("{} messages were suppressed by the rate limit", n));
+        }
+      }
+
+      if (m_pool) {
+        // the marker is handled by the background threads after everything
+        // queued before it; with more than one thread, messages taken by the
+        // other threads may still be in progress
+        auto* sinks = static_cast<LoggerSinks*>(m_owner.m_sinks.get());
+        sinks->wait(sinks->postFlush(*m_async), AsyncFlushTimeout);
+      } else {
+        m_owner.m_logger->flush();
+      }
+
+      if (auto batch = m_batch) {
+        static_cast<BatchCallbackSink*>(batch.get())->deliver();
+      }
+    } catch (...) {
+      // eat it
+    }
+  }
+
+  void setFile(const File& f, bool compress, std::uintmax_t maxTotalSize)
+  {
+    if (m_owner.m_file) {
+      auto* ds = static_cast<spdlog::sinks::dist_sink<std::mutex>*>(
+          m_owner.m_sinks.get());
+      ds->remove_sink(m_owner.m_file);
+      m_owner.m_file = {};
+    }
+
+    m_compressor.reset();
+
+    if (f.type != File::None) {
+      try {
+        if (compress && f.type != File::Single) {
+          m_compressor = std::make_shared<LogCompressor>(f, maxTotalSize);
+        }
+
+        m_owner.m_file = createFileSink(f, m_compressor);
+
+        if (m_owner.m_file) {
+          m_owner.addSink(m_owner.m_file);
+        }
+      } catch (spdlog::spdlog_ex& e) {
+        m_owner.error("{}", e.what());
+      }
+    }
+  }
+
+  void setBatchCallback(BatchCallback* f, std::chrono::milliseconds interval)
+  {
+    if (m_batch) {
+      auto* ds = static_cast<spdlog::sinks::dist_sink<std::mutex>*>(
+          m_owner.m_sinks.get());
+      ds->remove_sink(m_batch);
+      static_cast<BatchCallbackSink*>(m_batch.get())->deliver();
+      m_batch = {};
+    }
+
+    if (f) {
+      m_batch = std::make_shared<BatchCallbackSink>(f, interval);
+      m_owner.addSink(m_batch);
+    }
+  }
+
+  void setFlightRecorder(FlightRecorderConfiguration conf)
+  {
+    {
+      std::scoped_lock lock(m_recorderMutex);
+
+      if (conf.capacity == 0) {
+        m_recorder.store(nullptr, std::memory_order_release);
+      } else {
+        m_recorders.push_back(std::make_unique<FlightRecorder>(std::move(conf)));
+        m_recorder.store(m_recorders.back().get(), std::memory_order_release);
+      }
+    }
+
+    updateFormatLevel();
+  }
+
+  void dumpFlightRecorder()
+  {
+    if (auto* recorder = m_recorder.load(std::memory_order_acquire)) {
+      dump(*recorder);
+    }
+  }
+
+  void setBlacklist(const std::vector<BlacklistEntry>& entries)
+  {
+    std::shared_ptr<const Blacklist> bl;
+
+    if (!entries.empty()) {
+      bl = std::make_shared<const Blacklist>(entries);
+    }
+
+    m_blacklist.store(std::move(bl));
+  }
+
+  // replaces all the filters of the blacklist found in the given string in a
+  // single pass, see Logger::addToBlacklist()
+  //
+  void applyBlacklist(std::string& s) const noexcept
+  {
+    if (const auto bl = m_blacklist.load()) {
+      try {
+        bl->apply(s);
+      } catch (...) {
+        // eat it, the message is logged as-is
+      }
+    }
+  }
+
+  bool throttled(Levels lv, std::string_view format) noexcept
+  {
+    if (!m_throttle) {
+      return false;
+    }
+
+    std::uint64_t suppressed = 0;
+    const bool allowed =
+        m_throttle->allow(Throttle::site(format.data()), suppressed);
+
+    if (suppressed > 0) {
+      try {
+        logFormatted(lv, std::format("{} more messages like \"{}\" were suppressed",
+                                     suppressed, format));
+      } catch (...) {
+        // eat it
+      }
+    }
+
+    return !allowed;
+  }
+
+  bool throttled(Levels lv, const std::source_location& site) noexcept
+  {
+    if (!m_throttle) {
+      return false;
+    }
+
+    std::uint64_t suppressed = 0;
+    const bool allowed = m_throttle->allow(Throttle::site(site), suppressed);
+
+    if (suppressed > 0) {
+      try {
+        logFormatted(lv, std::format("{} more messages from {}:{} were suppressed",
+                                     suppressed, site.file_name(), site.line()));
+      } catch (...) {
+        // eat it
+      }
+    }
 
-  void setCallback(Callback* f) { m_f = f; }
+    return !allowed;
+  }
 
-protected:
-  void sink_it_(const spdlog::details::log_msg& m) override
+  // records, dumps and logs a formatted message as needed; `force` ignores the
+  // level of the logger, and `time` replaces the current time if set
+  //
+  void logFormatted(Levels lv, const std::string& s, bool force = false,
+                    std::chrono::system_clock::time_point time = {}) noexcept
   {
-    thread_local bool active = false;
+    const bool written = force || enabled(lv);
+
+    if (auto* recorder = m_recorder.load(std::memory_order_acquire)) {
+      // when dumped to the sinks, messages the logger writes are not recorded so
+      // they do not take the place of the others in the rings
+      if (recorder->records(lv)) {
+        if (!written || !recorder->configuration().file.empty()) {
+          recorder->record(lv, s);
+        }
+      } else if (lv == Error && recorder->configuration().dumpOnError) {
+        dump(*recorder);
+      }
+    }
 
-    if (active) {
-      // trying to log from a log callback, ignoring
+    if (!written) {
       return;
     }
 
-    if (!m_f) {
-      // disabled
-      return;
+    if (m_throttle) {
+      std::uint64_t repeats = 0;
+      Levels repeatLevel    = lv;
+
+      if (m_throttle->repeated(lv, s, repeats, repeatLevel)) {
+        return;
+      }
+
+      if (repeats > 0) {
+        try {
+          write(repeatLevel, std::format("last message repeated {} times", repeats));
+        } catch (...) {
+          // eat it
+        }
+      }
     }
 
+    write(lv, s, time);
+  }
+
+  // prefixes the message with the category and logs it regardless of the
+  // level of the logger
+  //
+  void logCategoryFormatted(std::string_view category, Levels lv,
+                            const std::string& s) noexcept
+  {
     try {
-      auto g = Guard([&] {
-        active = false;
-      });
-      active = true;
+      std::string prefixed;
+      prefixed.reserve(category.size() + 3 + s.size());
+      prefixed.append("[").append(category).append("] ").append(s);
+
+      logFormatted(lv, prefixed, true);
+    } catch (...) {
+      // eat it
+    }
+  }
+
+private:
+  Logger& m_owner;
+  LoggerOptions m_options;
+
+  std::atomic<Levels> m_level;
+
+  // lowest level that is either logged or recorded
+  std::atomic<Levels> m_formatLevel;
 
-      Entry e;
-      e.time    = m.time;
-      e.level   = fromSpdlog(m.level);
-      e.message = std::string(m.payload);
+  // the current recorder, null if disabled; replaced recorders are kept alive
+  // until the logger is destroyed since other threads may still use them
+  std::atomic<FlightRecorder*> m_recorder{nullptr};
+  std::vector<std::unique_ptr<FlightRecorder>> m_recorders;
+  std::mutex m_recorderMutex;
 
-      spdlog::memory_buf_t formatted;
-      base_sink::formatter_->format(m, formatted);
+  // null if neither rate limiting nor duplicate suppression are enabled
+  std::unique_ptr<Throttle> m_throttle;
 
-      if (formatted.size() >= 2) {
-        // remove \r\n
-        e.formattedMessage.assign(formatted.begin(), formatted.end() - 2);
+  // compiled from the blacklist of the configuration, null when empty; swapped
+  // atomically so messages being logged keep the version they loaded
+  std::atomic<std::shared_ptr<const Blacklist>> m_blacklist;
+
+  std::shared_ptr<spdlog::sinks::sink> m_batch;
+
+  // set if the file is compressed, see Logger::setCompressedFile()
+  std::shared_ptr<LogCompressor> m_compressor;
+
+  // background threads and the logger queuing to them in async mode, and
+  // periodic flush if enabled
+  std::shared_ptr<spdlog::details::thread_pool> m_pool;
+  std::shared_ptr<spdlog::async_logger> m_async;
+  std::unique_ptr<spdlog::details::periodic_worker> m_flusher;
+
+  // writes a message to the sinks, bypassing the level of the logger
+  //
+  void write(Levels lv, std::string_view s,
+             std::chrono::system_clock::time_point time = {}) noexcept
+  {
+    try {
+      // multi-line messages are logged as a single message, each line gets the
+      // pattern when formatted, see MultilineFormatter
+      const spdlog::string_view_t sv(s.data(), s.size());
+
+      if (time == std::chrono::system_clock::time_point{}) {
+        target().log(toSpdlog(lv), sv);
       } else {
-        e.formattedMessage = std::string(formatted);
+        target().log(time, spdlog::source_loc{}, toSpdlog(lv), sv);
       }
-
-      (*m_f)(std::move(e));
-    } catch (std::exception& e) {
-      fprintf(stderr, "uncaugh exception in logging callback, %s\n", e.what());
     } catch (...) {
-      fprintf(stderr, "uncaught exception in logging callback\n");
+      // eat it
     }
   }
 
-  void flush_() override
+  void updateFormatLevel()
   {
-    // no-op
+    std::scoped_lock lock(m_recorderMutex);
+
+    auto lv = level();
+    if (auto* recorder = m_recorder.load(std::memory_order_relaxed)) {
+      lv = std::min(lv, recorder->configuration().level);
+    }
+
+    m_formatLevel.store(lv, std::memory_order_relaxed);
   }
 
-private:
-  std::atomic<Callback*> m_f;
+  void dump(FlightRecorder& recorder) noexcept
+  {
+    try {
+      std::scoped_lock lock(m_recorderMutex);
+
+      auto entries     = recorder.take();
+      const auto& file = recorder.configuration().file;
+
+      if (!file.empty()) {
+        if (entries.empty()) {
+          return;
+        }
+
+        std::ofstream out(file, std::ios::app | std::ios::binary);
+        if (!out) {
+          std::cerr << "failed to open flight recorder dump " << file.string()
+                    << "\n";
+          return;
+        }
+
+        out << std::format("flight recorder, {} messages:\n", entries.size());
+        for (const auto& e : entries) {
+          out << e.formattedMessage << "\n";
+        }
+
+        return;
+      }
+
+      if (entries.empty()) {
+        return;
+      }
+
+      // written with their original time and level, bypassing the level of
+      // the logger; this goes through the spdlog logger so that, in async
+      // mode, the messages are queued in order with the others
+      write(Info, std::format("flight recorder, last {} messages:", entries.size()),
+            std::chrono::system_clock::now());
+
+      for (const auto& e : entries) {
+        write(e.level, e.message, e.time);
+      }
+
+      write(Info, "end of flight recorder", std::chrono::system_clock::now());
+      target().flush();
+    } catch (...) {
+      // eat it
+    }
+  }
 };
 
-File::File() : type(None), maxSize(0), maxFiles(0), dailyHour(0), dailyMinute(0) {}
+}  // namespace details
 
-File File::daily(fs::path file, int hour, int minute)
+Logger::Logger(LoggerConfiguration conf) : Logger(std::move(conf), LoggerOptions{})
+{}
+
+Logger::Logger(LoggerConfiguration conf_moved, LoggerOptions options)
+    : m_conf(std::move(conf_moved)),
+      m_impl(std::make_unique<details::LoggerImpl>(*this, std::move(options)))
 {
-  File fl;
+  createLogger(m_conf.name);
+  compileBlacklist();
 
-  fl.type        = Daily;
-  fl.file        = std::move(file);
-  fl.dailyHour   = hour;
-  fl.dailyMinute = minute;
+  m_logger->set_formatter(createFormatter(m_conf.pattern, m_conf.utc));
 
-  return fl;
+  m_impl->setFlightRecorder(m_impl->options().flightRecorder);
 }
 
-File File::rotating(fs::path file, std::size_t maxSize, std::size_t maxFiles)
+Logger::~Logger()
 {
-  File fl;
-
-  fl.type     = Rotating;
-  fl.file     = std::move(file);
-  fl.maxSize  = maxSize;
-  fl.maxFiles = maxFiles;
+  // flushes and joins the background threads before the sinks are destroyed
+  m_impl.reset();
+}
 
-  return fl;
+void Logger::flush()
+{
+  m_impl->flush();
 }
 
-File File::single(std::filesystem::path file)
+Levels Logger::level() const
 {
-  File fl;
+  return m_impl->level();
+}
 
-  fl.type = Single;
-  fl.file = std::move(file);
+void Logger::setLevel(Levels lv)
+{
+  m_impl->setLevel(lv);
+}
 
-  return fl;
+bool Logger::enabled(Levels lv) const noexcept
+{
+  return m_impl->enabled(lv);
 }
 
-spdlog::sink_ptr createFileSink(const File& f)
+bool Logger::formatted(Levels lv) const noexcept
 {
-  try {
-    switch (f.type) {
-    case File::Daily: {
-      return std::make_shared<spdlog::sinks::daily_file_sink_mt>(
-          f.file.native(), f.dailyHour, f.dailyMinute);
-    }
+  return m_impl->formatted(lv);
+}
 
-    case File::Rotating: {
-      return std::make_shared<spdlog::sinks::rotating_file_sink_mt>(
-          f.file.native(), f.maxSize, f.maxFiles);
-    }
+void Logger::setFlightRecorder(FlightRecorderConfiguration conf)
+{
+  m_impl->setFlightRecorder(std::move(conf));
+}
 
-    case File::Single: {
-      return std::make_shared<spdlog::sinks::basic_file_sink_mt>(f.file.native(), true);
-    }
+void Logger::dumpFlightRecorder()
+{
+  m_impl->dumpFlightRecorder();
+}
 
-    case File::None:  // fall-through
-    default:
-      return {};
-    }
-  } catch (spdlog::spdlog_ex& e) {
-    std::cerr << "failed to create file log, " << e.what() << "\n";
-    return {};
-  }
+void Logger::logMessage(Levels lv, std::string message) noexcept
+{
+  m_impl->applyBlacklist(message);
+  m_impl->logFormatted(lv, message);
 }
 
-Logger::Logger(LoggerConfiguration conf_moved) : m_conf(std::move(conf_moved))
+void Logger::logCategoryMessage(std::string_view category, Levels lv,
+                                std::string message) noexcept
 {
-  createLogger(m_conf.name);
+  m_impl->applyBlacklist(message);
+  m_impl->logCategoryFormatted(category, lv, message);
+}
 
-  const auto timeType =
-      m_conf.utc ? spdlog::pattern_time_type::utc : spdlog::pattern_time_type::local;
+void Logger::logAt(const std::source_location& site, Levels lv,
+                   std::string message) noexcept
+{
+  if (!formatted(lv) || m_impl->throttled(lv, site)) {
+    return;
+  }
 
-  m_logger->set_level(toSpdlog(m_conf.maxLevel));
-  m_logger->set_pattern(m_conf.pattern, timeType);
-  m_logger->flush_on(spdlog::level::trace);
+  logMessage(lv, std::move(message));
 }
 
-// anchor
-Logger::~Logger() = default;
+void Logger::logForwarded(Levels lv, std::chrono::system_clock::time_point time,
+                          std::string_view format, std::string message) noexcept
+{
+  if (!formatted(lv) || (!format.empty() && throttled(lv, format))) {
+    return;
+  }
+
+  m_impl->applyBlacklist(message);
+  m_impl->logFormatted(lv, message, false, time);
+}
 
-Levels Logger::level() const
+void Logger::logCategoryAt(const std::source_location& site, std::string_view category,
+                           Levels lv, std::string message) noexcept
 {
-  return fromSpdlog(m_logger->level());
+  if (m_impl->throttled(lv, site)) {
+    return;
+  }
+
+  logCategoryMessage(category, lv, std::move(message));
 }
 
-void Logger::setLevel(Levels lv)
+bool Logger::throttled(Levels lv, std::string_view format) noexcept
 {
-  m_logger->set_level(toSpdlog(lv));
+  return m_impl->throttled(lv, format);
 }
 
 void Logger::setPattern(const std::string& s)
 {
-  m_logger->set_pattern(s);
+  m_logger->set_formatter(createFormatter(s, m_conf.utc));
 }
 
 void Logger::setFile(const File& f)
 {
+  m_impl->setFile(f, false, 0);
+}
 
-  if (m_file) {
-    auto* ds = static_cast<spdlog::sinks::dist_sink<std::mutex>*>(m_sinks.get());
-    ds->remove_sink(m_file);
-    m_file = {};
-  }
-
-  if (f.type != File::None) {
-    try {
-      m_file = createFileSink(f);
+void Logger::setCompressedFile(const File& f, std::uintmax_t maxTotalSize)
+{
+  m_impl->setFile(f, true, maxTotalSize);
+}
 
-      if (m_file) {
-        addSink(m_file);
-      }
-    } catch (spdlog::spdlog_ex& e) {
-      error("{}", e.what());
-    }
+void Logger::setCallback(Callback* f)
+{
+  if (!m_callback) {
+    m_callback.reset(new CallbackSink);
+    addSink(m_callback);
   }
+
+  static_cast<CallbackSink*>(m_callback.get())->setCallback(f);
 }
 
-void Logger::setCallback(Callback* f)
+void Logger::setViewCallback(ViewCallback* f)
 {
-  if (m_callback) {
-    static_cast<CallbackSink*>(m_callback.get())->setCallback(f);
-  } else {
-    m_callback.reset(new CallbackSink(f));
+  if (!m_callback) {
+    m_callback.reset(new CallbackSink);
     addSink(m_callback);
   }
+
+  static_cast<CallbackSink*>(m_callback.get())->setViewCallback(f);
+}
+
+void Logger::setBatchCallback(BatchCallback* f, std::chrono::milliseconds interval)
+{
+  m_impl->setBatchCallback(f, interval);
 }
 
 void Logger::addToBlacklist(const std::string& filter, const std::string& replacement)
@@ -268,6 +1666,8 @@ void Logger::addToBlacklist(const std::string& filter, const std::string& replac
   if (!present) {
     m_conf.blacklist.push_back(BlacklistEntry(filter, replacement));
   }
+
+  compileBlacklist();
 }
 
 void Logger::removeFromBlacklist(const std::string& filter)
@@ -284,16 +1684,24 @@ void Logger::removeFromBlacklist(const std::string& filter)
       ++it;
     }
   }
+
+  compileBlacklist();
 }
 
 void Logger::resetBlacklist()
 {
   m_conf.blacklist.clear();
+  compileBlacklist();
+}
+
+void Logger::compileBlacklist()
+{
+  m_impl->setBlacklist(m_conf.blacklist);
 }
 
 void Logger::createLogger(const std::string& name)
 {
-  m_sinks.reset(new spdlog::sinks::dist_sink<std::mutex>);
+  m_sinks.reset(new LoggerSinks);
 
   DWORD console_mode;
   if (::GetConsoleMode(::GetStdHandle(STD_ERROR_HANDLE), &console_mode) != 0) {
@@ -310,7 +1718,7 @@ void Logger::createLogger(const std::string& name)
     addSink(m_console);
   }
 
-  m_logger.reset(new spdlog::logger(name, m_sinks));
+  m_impl->createLogger(name, m_sinks);
 }
 
 void Logger::addSink(std::shared_ptr<spdlog::sinks::sink> sink)
@@ -333,15 +1741,122 @@ void Logger::addSink(std::shared_ptr<spdlog::sinks::sink> sink)
 
   auto* ds = static_cast<spdlog::sinks::dist_sink<std::mutex>*>(m_sinks.get());
 
-  const auto timeType =
-      m_conf.utc ? spdlog::pattern_time_type::utc : spdlog::pattern_time_type::local;
-
-  sink->set_formatter(
-      std::make_unique<spdlog::pattern_formatter>(m_conf.pattern, timeType));
+  sink->set_formatter(createFormatter(m_conf.pattern, m_conf.utc));
 
   ds->add_sink(sink);
 }
 
+// categories are never destroyed, so references can be kept; rules are kept
+// in order so the last matching one wins for categories created later
+//
+struct Categories
+{
+  std::mutex mutex;
+  std::map<std::string, std::unique_ptr<Category>, std::less<>> categories;
+  std::vector<std::pair<std::string, std::optional<Levels>>> rules;
+};
+
+static Categories& categories()
+{
+  static Categories c;
+  return c;
+}
+
+// ASCII case-insensitive match where '*' matches any sequence
+//
+static bool wildcardMatch(std::string_view pattern, std::string_view s)
+{
+  const auto lower = [](char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+  };
+
+  std::size_t p = 0, i = 0;
+  std::size_t star = std::string_view::npos, resume = 0;
+
+  while (i < s.size()) {
+    if (p < pattern.size() && pattern[p] == '*') {
+      star   = p++;
+      resume = i;
+    } else if (p < pattern.size() && lower(pattern[p]) == lower(s[i])) {
+      ++p;
+      ++i;
+    } else if (star != std::string_view::npos) {
+      p = star + 1;
+      i = ++resume;
+    } else {
+      return false;
+    }
+  }
+
+  while (p < pattern.size() && pattern[p] == '*') {
+    ++p;
+  }
+
+  return p == pattern.size();
+}
+
+Category::Category(std::string name)
+    : m_name(std::move(name)), m_level(FollowDefault)
+{}
+
+const std::string& Category::name() const
+{
+  return m_name;
+}
+
+std::optional<Levels> Category::level() const
+{
+  const auto level = m_level.load(std::memory_order_relaxed);
+  if (level == FollowDefault) {
+    return {};
+  }
+
+  return static_cast<Levels>(level);
+}
+
+void Category::setLevel(std::optional<Levels> lv)
+{
+  m_level.store(lv ? static_cast<int>(*lv) : FollowDefault, std::memory_order_relaxed);
+}
+
+Category& category(std::string_view name)
+{
+  auto& c = categories();
+  std::scoped_lock lock(c.mutex);
+
+  if (auto itor = c.categories.find(name); itor != c.categories.end()) {
+    return *itor->second;
+  }
+
+  auto cat = std::make_unique<Category>(std::string(name));
+  for (const auto& [pattern, lv] : c.rules) {
+    if (wildcardMatch(pattern, name)) {
+      cat->setLevel(lv);
+    }
+  }
+
+  return *c.categories.emplace(std::string(name), std::move(cat)).first->second;
+}
+
+void setCategoryLevel(std::string_view pattern, std::optional<Levels> lv)
+{
+  auto& c = categories();
+  std::scoped_lock lock(c.mutex);
+
+  // a rule replaces the previous rules it covers, they would never apply
+  std::erase_if(c.rules, [&](auto&& r) {
+    return wildcardMatch(pattern, r.first);
+  });
+
+  c.rules.emplace_back(std::string(pattern), lv);
+
+  for (auto& [name, cat] : c.categories) {
+    if (wildcardMatch(pattern, name)) {
+      cat->setLevel(lv);
+    }
+  }
+}
+
 QString levelToString(Levels level)
 {
   const auto spdlogLevel = toSpdlog(level);
@@ -356,6 +1871,11 @@ void createDefault(LoggerConfiguration conf)
   g_default = std::make_unique<Logger>(conf);
 }
 
+void createDefault(LoggerConfiguration conf, LoggerOptions options)
+{
+  g_default = std::make_unique<Logger>(std::move(conf), std::move(options));
+}
+
 Logger& getDefault()
 {
   Q_ASSERT(g_default);
@@ -369,27 +1889,162 @@ namespace MOBase::log::details
 
 void doLogImpl(spdlog::logger& lg, Levels lv, const std::string& s) noexcept
 {
+  // the blacklist has already been applied by the caller
+  if (auto* owned = dynamic_cast<OwnedLogger*>(&lg)) {
+    owned->owner().logFormatted(lv, s);
+    return;
+  }
+
   try {
-    const char* start = s.c_str();
-    const char* p     = start;
+    lg.log(toSpdlog(lv), spdlog::string_view_t(s.data(), s.size()));
+  } catch (...) {
+    // eat it
+  }
+}
 
-    for (;;) {
-      while (*p && *p != '\n') {
-        ++p;
+Blacklist::Blacklist(std::vector<BlacklistEntry> entries)
+    : m_entries(std::move(entries))
+{
+  const auto fold = [](char c) {
+    const auto u = static_cast<unsigned char>(c);
+    return static_cast<unsigned char>(u >= 'a' && u <= 'z' ? u - 'a' + 'A' : u);
+  };
+
+  // classes, lower case letters share the class of their upper case counterpart
+  for (const auto& e : m_entries) {
+    for (char c : e.filter) {
+      auto& cl = m_classes[fold(c)];
+      if (cl == 0) {
+        cl = static_cast<std::uint16_t>(m_classCount++);
+      }
+    }
+  }
+  for (unsigned char c = 'a'; c <= 'z'; ++c) {
+    m_classes[c] = m_classes[c - 'a' + 'A'];
+  }
+
+  // trie, a 0 transition means no child since the root is never a child
+  const auto addState = [this](std::uint32_t depth) {
+    const auto state = static_cast<std::uint32_t>(m_depth.size());
+    m_transitions.resize(m_transitions.size() + m_classCount, 0);
+    m_depth.push_back(depth);
+    m_matchLength.push_back(0);
+    m_matchEntry.push_back(0);
+    return state;
+  };
+
+  addState(0);
+
+  for (std::size_t i = 0; i < m_entries.size(); ++i) {
+    const auto& filter = m_entries[i].filter;
+    if (filter.empty()) {
+      continue;
+    }
+
+    std::uint32_t state = 0;
+    for (char c : filter) {
+      const auto t = state * m_classCount + m_classes[static_cast<unsigned char>(c)];
+      if (m_transitions[t] == 0) {
+        const auto child = addState(m_depth[state] + 1);
+        m_transitions[t] = child;
       }
+      state = m_transitions[t];
+    }
 
-      std::string_view sv(start, static_cast<std::size_t>(p - start));
-      lg.log(toSpdlog(lv), "{}", sv);
+    // duplicate filters: the first one wins, as when replacing them one by one
+    if (m_matchLength[state] == 0) {
+      m_matchLength[state] = static_cast<std::uint32_t>(filter.size());
+      m_matchEntry[state]  = static_cast<std::uint32_t>(i);
+    }
+  }
 
-      if (!*p) {
-        break;
+  // failure links in breadth-first order, completing the transition table and
+  // propagating the longest match through the links
+  std::vector<std::uint32_t> fail(m_depth.size(), 0);
+  std::vector<std::uint32_t> queue;
+  queue.reserve(m_depth.size());
+
+  for (std::size_t cl = 0; cl < m_classCount; ++cl) {
+    if (const auto child = m_transitions[cl]; child != 0) {
+      queue.push_back(child);
+    }
+  }
+
+  for (std::size_t q = 0; q < queue.size(); ++q) {
+    const auto state = queue[q];
+    const auto link  = fail[state];
+
+    if (m_matchLength[state] == 0) {
+      m_matchLength[state] = m_matchLength[link];
+      m_matchEntry[state]  = m_matchEntry[link];
+    }
+
+    for (std::size_t cl = 0; cl < m_classCount; ++cl) {
+      auto& t            = m_transitions[state * m_classCount + cl];
+      const auto linkedT = m_transitions[link * m_classCount + cl];
+
+      if (t != 0) {
+        fail[t] = linkedT;
+        queue.push_back(t);
+      } else {
+        t = linkedT;
       }
+    }
+  }
+}
 
-      ++p;
-      start = p;
+void Blacklist::apply(std::string& s) const
+{
+  constexpr auto npos = std::string::npos;
+
+  std::string out;
+  bool replaced = false;
+
+  // start of the text not copied to out yet, and best match starting after it
+  std::size_t copied     = 0;
+  std::size_t bestStart  = npos;
+  std::size_t bestLength = 0;
+  std::uint32_t bestEntry = 0;
+
+  std::uint32_t state = 0;
+  std::size_t i       = 0;
+
+  while (i < s.size() || bestStart != npos) {
+    if (i < s.size()) {
+      state = next(state, s[i]);
+      ++i;
+
+      if (const std::size_t length = m_matchLength[state]; length > 0) {
+        const auto start = i - length;
+        if (start < bestStart || (start == bestStart && length > bestLength)) {
+          bestStart  = start;
+          bestLength = length;
+          bestEntry  = m_matchEntry[state];
+        }
+      }
     }
-  } catch (...) {
-    // eat it
+
+    // the best match is final once no match in progress can start before it
+    if (bestStart != npos && (i == s.size() || i - m_depth[state] > bestStart)) {
+      if (!replaced) {
+        out.reserve(s.size());
+        replaced = true;
+      }
+
+      out.append(s, copied, bestStart - copied);
+      out.append(m_entries[bestEntry].replacement);
+
+      // matches cannot overlap, restart right after the replaced text
+      copied = i = bestStart + bestLength;
+      state      = 0;
+      bestStart  = npos;
+      bestLength = 0;
+    }
+  }
+
+  if (replaced) {
+    out.append(s, copied);
+    s = std::move(out);
   }
 }
 
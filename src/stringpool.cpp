@@ -0,0 +1,204 @@
+#include "stringpool.h"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <QHash>
+
+#include "ifiletree.h"
+
+namespace MOBase
+{
+
+namespace
+{
+
+struct Interned
+{
+  QString string;
+
+  // FileNameHash of the string, computed once when it is interned
+  std::size_t fileNameHash;
+};
+
+struct StringHash
+{
+  using is_transparent = void;
+
+  std::size_t operator()(QStringView s) const noexcept { return qHash(s); }
+  std::size_t operator()(const Interned& s) const noexcept
+  {
+    return qHash(QStringView(s.string));
+  }
+};
+
+struct StringEqual
+{
+  using is_transparent = void;
+
+  bool operator()(QStringView a, const Interned& b) const noexcept
+  {
+    return a == b.string;
+  }
+  bool operator()(const Interned& a, QStringView b) const noexcept
+  {
+    return a.string == b;
+  }
+  bool operator()(const Interned& a, const Interned& b) const noexcept
+  {
+    return a.string == b.string;
+  }
+};
+
+class Pool
+{
+public:
+  QString intern(QStringView s)
+  {
+    const auto hash = qHash(s);
+    auto& shard     = shardFor(hash);
+
+    std::scoped_lock lock(shard.mutex);
+
+    if (auto it = shard.strings.find(s); it != shard.strings.end()) {
+      return it->string;
+    }
+
+    if (shard.strings.size() >= shard.sweepAt) {
+      sweep(shard);
+    }
+
+    const auto& added = *shard.strings.insert({s.toString(), FileNameHash{}(s)}).first;
+
+    auto& index = indexFor(added.string.constData());
+    std::unique_lock indexLock(index.mutex);
+    index.hashes.emplace(added.string.constData(), &added);
+
+    return added.string;
+  }
+
+  std::optional<std::size_t> fileNameHash(QStringView s)
+  {
+    auto& index = indexFor(s.data());
+    std::shared_lock lock(index.mutex);
+
+    const auto it = index.hashes.find(s.data());
+    if (it == index.hashes.end() || it->second->string.size() != s.size()) {
+      return {};
+    }
+
+    return it->second->fileNameHash;
+  }
+
+  std::size_t size()
+  {
+    std::size_t n = 0;
+
+    for (auto& shard : m_shards) {
+      std::scoped_lock lock(shard.mutex);
+      sweep(shard);
+      n += shard.strings.size();
+    }
+
+    return n;
+  }
+
+private:
+  static constexpr std::size_t ShardBits = 6;
+  static constexpr std::size_t MinSweep  = 64;
+
+  struct Shard
+  {
+    std::mutex mutex;
+    std::unordered_set<Interned, StringHash, StringEqual> strings;
+    std::size_t sweepAt = MinSweep;
+  };
+
+  // interned strings by address, so their hash can be found without reading them
+  struct Index
+  {
+    std::shared_mutex mutex;
+    std::unordered_map<const QChar*, const Interned*> hashes;
+  };
+
+  std::array<Shard, std::size_t(1) << ShardBits> m_shards;
+  std::array<Index, std::size_t(1) << ShardBits> m_indices;
+
+  // the high bits pick the shard, the sets use the low ones for their buckets
+  Shard& shardFor(std::size_t hash)
+  {
+    return m_shards[hash >> (sizeof(std::size_t) * CHAR_BIT - ShardBits)];
+  }
+
+  Index& indexFor(const QChar* p)
+  {
+    const auto bits = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(p)) *
+                      0x9e3779b97f4a7c15ull;
+    return m_indices[bits >> (64 - ShardBits)];
+  }
+
+  // removes the strings only referenced by the pool; copies are only made with
+  // the shard locked, so a string that is detached here cannot be shared again
+  // before it is removed
+  //
+  // the address of a string is removed from the index before the string is freed,
+  // so a new string allocated at the same address is never mistaken for it
+  //
+  void sweep(Shard& shard)
+  {
+    std::erase_if(shard.strings, [&](const Interned& s) {
+      if (!s.string.isDetached()) {
+        return false;
+      }
+
+      auto& index = indexFor(s.string.constData());
+      std::unique_lock lock(index.mutex);
+      index.hashes.erase(s.string.constData());
+
+      return true;
+    });
+
+    shard.sweepAt = std::max(MinSweep, shard.strings.size() * 2);
+  }
+};
+
+// never destroyed, strings in static objects may be interned during their
+// destruction otherwise
+Pool& pool()
+{
+  static auto* p = new Pool;
+  return *p;
+}
+
+}  // namespace
+
+QString internString(QStringView s)
+{
+  if (s.isEmpty()) {
+    return {};
+  }
+
+  return pool().intern(s);
+}
+
+std::optional<std::size_t> internedFileNameHash(QStringView s)
+{
+  if (s.isEmpty()) {
+    return {};
+  }
+
+  return pool().fileNameHash(s);
+}
+
+std::size_t internedStringCount()
+{
+  return pool().size();
+}
+
+}  // namespace MOBase
@@ -1,7 +1,29 @@
 #include "strings.h"
 
 #include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <locale>
+#include <string>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define UIBASE_STRINGS_SIMD 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define UIBASE_STRINGS_SIMD 0
+#endif
+
+// msvc allows any intrinsic in any function, gcc and clang need the functions
+// using avx2 to be marked
+#if UIBASE_STRINGS_SIMD && !defined(_MSC_VER)
+#define UIBASE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define UIBASE_TARGET_AVX2
+#endif
 
 namespace MOBase
 {
@@ -21,26 +43,356 @@ public:
   }
 };
 
+namespace
+{
+
+// ascii fast paths
+//
+// the locale is only needed for bytes outside of ascii, so both strings are
+// checked and compared with a simple case-folding when they are ascii; the
+// vectorized versions are picked at runtime depending on the cpu
+//
+
+enum class AsciiCompare
+{
+  Equal,
+  Different,
+  NonAscii
+};
+
+constexpr char foldAscii(char c)
+{
+  return (c >= 'a' && c <= 'z') ? static_cast<char>(c - ('a' - 'A')) : c;
+}
+
+constexpr bool isAsciiChar(char c)
+{
+  return (static_cast<unsigned char>(c) & 0x80) == 0;
+}
+
+bool isAsciiScalar(const char* s, std::size_t n)
+{
+  return std::all_of(s, s + n, isAsciiChar);
+}
+
+AsciiCompare iequalsScalar(const char* a, const char* b, std::size_t n)
+{
+  for (std::size_t i = 0; i < n; ++i) {
+    if (!isAsciiChar(a[i]) || !isAsciiChar(b[i])) {
+      return AsciiCompare::NonAscii;
+    }
+
+    if (foldAscii(a[i]) != foldAscii(b[i])) {
+      return AsciiCompare::Different;
+    }
+  }
+
+  return AsciiCompare::Equal;
+}
+
+#if UIBASE_STRINGS_SIMD
+
+// sse2 is part of x64, so it is always available
+//
+__m128i foldSse2(__m128i x)
+{
+  // bytes outside of ascii are negative and never in the range
+  const auto lower =
+      _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('a' - 1)),
+                    _mm_cmplt_epi8(x, _mm_set1_epi8('z' + 1)));
+
+  return _mm_sub_epi8(x, _mm_and_si128(lower, _mm_set1_epi8('a' - 'A')));
+}
+
+bool isAsciiSse2(const char* s, std::size_t n)
+{
+  std::size_t i = 0;
+  auto acc      = _mm_setzero_si128();
+
+  for (; i + 16 <= n; i += 16) {
+    acc = _mm_or_si128(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i)));
+  }
+
+  return _mm_movemask_epi8(acc) == 0 && isAsciiScalar(s + i, n - i);
+}
+
+AsciiCompare iequalsSse2(const char* a, const char* b, std::size_t n)
+{
+  std::size_t i = 0;
+
+  for (; i + 16 <= n; i += 16) {
+    const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    const auto y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+
+    if (_mm_movemask_epi8(_mm_or_si128(x, y)) != 0) {
+      return AsciiCompare::NonAscii;
+    }
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(foldSse2(x), foldSse2(y))) != 0xffff) {
+      return AsciiCompare::Different;
+    }
+  }
+
+  return iequalsScalar(a + i, b + i, n - i);
+}
+
+UIBASE_TARGET_AVX2 __m256i foldAvx2(__m256i x)
+{
+  const auto lower =
+      _mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8('a' - 1)),
+                       _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), x));
+
+  return _mm256_sub_epi8(x, _mm256_and_si256(lower, _mm256_set1_epi8('a' - 'A')));
+}
+
+UIBASE_TARGET_AVX2 bool isAsciiAvx2(const char* s, std::size_t n)
+{
+  std::size_t i = 0;
+  auto acc      = _mm256_setzero_si256();
+
+  for (; i + 32 <= n; i += 32) {
+    acc = _mm256_or_si256(
+        acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i)));
+  }
+
+  return _mm256_movemask_epi8(acc) == 0 && isAsciiSse2(s + i, n - i);
+}
+
+UIBASE_TARGET_AVX2 AsciiCompare iequalsAvx2(const char* a, const char* b,
+                                            std::size_t n)
+{
+  std::size_t i = 0;
+
+  for (; i + 32 <= n; i += 32) {
+    const auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    const auto y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+
+    if (_mm256_movemask_epi8(_mm256_or_si256(x, y)) != 0) {
+      return AsciiCompare::NonAscii;
+    }
+
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(foldAvx2(x), foldAvx2(y))) != -1) {
+      return AsciiCompare::Different;
+    }
+  }
+
+  return iequalsSse2(a + i, b + i, n - i);
+}
+
+bool cpuHasAvx2()
+{
+#ifdef _MSC_VER
+  int regs[4] = {};
+
+  __cpuid(regs, 0);
+  if (regs[0] < 7) {
+    return false;
+  }
+
+  // the os must also save the ymm registers
+  __cpuid(regs, 1);
+  const bool osxsave = (regs[2] & (1 << 27)) != 0;
+  const bool avx     = (regs[2] & (1 << 28)) != 0;
+
+  if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+    return false;
+  }
+
+  __cpuidex(regs, 7, 0);
+  return (regs[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+struct AsciiFunctions
+{
+  bool (*isAscii)(const char*, std::size_t);
+  AsciiCompare (*iequals)(const char*, const char*, std::size_t);
+};
+
+AsciiFunctions pickAsciiFunctions()
+{
+#if UIBASE_STRINGS_SIMD
+  if (cpuHasAvx2()) {
+    return {&isAsciiAvx2, &iequalsAvx2};
+  }
+
+  return {&isAsciiSse2, &iequalsSse2};
+#else
+  return {&isAsciiScalar, &iequalsScalar};
+#endif
+}
+
+const AsciiFunctions& ascii()
+{
+  static const AsciiFunctions f = pickAsciiFunctions();
+  return f;
+}
+
+bool isAscii(std::string_view s)
+{
+  return ascii().isAscii(s.data(), s.size());
+}
+
+// compares with the locale, for strings that are not ascii
+//
+bool iequalsLocale(std::string_view lhs, std::string_view rhs, const is_iequal& equal)
+{
+  return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), equal);
+}
+
+// Horspool search of an ascii needle, case-insensitive; the skip table is indexed
+// by folded bytes so both cases shift the same
+//
+// windows of the text containing bytes outside of ascii are compared with the
+// locale, and a byte outside of ascii at the end of a window only shifts by one
+// since the locale may fold it to any character of the needle
+//
+class AsciiSearcher
+{
+public:
+  AsciiSearcher(std::string_view needle) : m_needle(needle)
+  {
+    const auto m = needle.size();
+
+    m_skip.fill(m);
+    for (std::size_t k = 0; k + 1 < m; ++k) {
+      m_skip[static_cast<unsigned char>(foldAscii(needle[k]))] = m - 1 - k;
+    }
+
+    for (std::size_t c = 0x80; c < m_skip.size(); ++c) {
+      m_skip[c] = 1;
+    }
+
+    m_last = foldAscii(needle[m - 1]);
+  }
+
+  std::size_t find(std::string_view text, std::size_t from,
+                   const is_iequal& equal) const
+  {
+    const auto m = m_needle.size();
+
+    for (auto pos = from; pos + m <= text.size();) {
+      const auto c = foldAscii(text[pos + m - 1]);
+
+      if (!isAsciiChar(c)) {
+        if (iequalsLocale(text.substr(pos, m), m_needle, equal)) {
+          return pos;
+        }
+      } else if (c == m_last) {
+        switch (ascii().iequals(text.data() + pos, m_needle.data(), m - 1)) {
+        case AsciiCompare::Equal:
+          return pos;
+
+        case AsciiCompare::NonAscii:
+          if (iequalsLocale(text.substr(pos, m), m_needle, equal)) {
+            return pos;
+          }
+          break;
+
+        case AsciiCompare::Different:
+        default:
+          break;
+        }
+      }
+
+      pos += m_skip[static_cast<unsigned char>(c)];
+    }
+
+    return std::string_view::npos;
+  }
+
+private:
+  std::string_view m_needle;
+  std::array<std::size_t, 256> m_skip;
+  char m_last;
+};
+
+// replaces every match in a single pass instead of replacing in place, which
+// would move the rest of the string for every match; find(text, from) returns
+// the next match at or after from
+//
+template <class Find>
+void replaceMatches(std::string& input, std::size_t length, std::string_view replace,
+                    Find&& find)
+{
+  auto pos = find(input, 0);
+  if (pos == std::string_view::npos) {
+    return;
+  }
+
+  std::string out;
+  out.reserve(input.size());
+
+  std::size_t last = 0;
+  while (pos != std::string_view::npos) {
+    out.append(input, last, pos - last);
+    out.append(replace);
+    last = pos + length;
+    pos  = find(input, last);
+  }
+
+  out.append(input, last);
+  input = std::move(out);
+}
+
+}  // namespace
+
 bool iequals(std::string_view lhs, std::string_view rhs)
 {
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+
+  switch (ascii().iequals(lhs.data(), rhs.data(), lhs.size())) {
+  case AsciiCompare::Equal:
+    return true;
+
+  case AsciiCompare::Different:
+    return false;
+
+  case AsciiCompare::NonAscii:
+  default:
+    break;
+  }
+
   return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), is_iequal());
 }
 
 void ireplace_all(std::string& input, std::string_view search,
                   std::string_view replace) noexcept
 {
-  const auto search_length  = static_cast<std::string::difference_type>(search.size());
-  const auto replace_length = replace.size();
+  if (search.empty() || input.size() < search.size()) {
+    return;
+  }
 
-  std::size_t i = 0;
-  while (input.size() - i >= search_length) {
-    if (iequals(std::string_view(input).substr(i, search_length), search)) {
-      input.replace(i, search_length, replace);
-      i += replace_length;
-    } else {
-      ++i;
-    }
+  const is_iequal equal;
+
+  if (isAscii(search)) {
+    const AsciiSearcher searcher(search);
+
+    replaceMatches(input, search.size(), replace,
+                   [&](std::string_view text, std::size_t from) {
+                     return searcher.find(text, from, equal);
+                   });
+
+    return;
   }
+
+  replaceMatches(input, search.size(), replace,
+                 [&](std::string_view text, std::size_t from) {
+                   for (auto pos = from; pos + search.size() <= text.size(); ++pos) {
+                     if (iequalsLocale(text.substr(pos, search.size()), search,
+                                       equal)) {
+                       return pos;
+                     }
+                   }
+
+                   return std::string_view::npos;
+                 });
 }
 
 }  // namespace MOBase
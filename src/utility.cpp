@@ -754,31 +754,31 @@ QString ToString(const SYSTEMTIME& time)
   return QString::fromLocal8Bit(dateBuffer) + " " + QString::fromLocal8Bit(timeBuffer);
 }
 
-static int naturalCompareI(const QString& a, const QString& b)
+// collators are not thread-safe, each thread has its own
+//
+static QCollator& naturalCollator(Qt::CaseSensitivity cs)
 {
-  static QCollator c = [] {
-    QCollator temp;
-    temp.setNumericMode(true);
-    temp.setCaseSensitivity(Qt::CaseInsensitive);
-    return temp;
-  }();
-
-  return c.compare(a, b);
+  const auto make = [](Qt::CaseSensitivity sensitivity) {
+    QCollator c;
+    c.setNumericMode(true);
+    c.setCaseSensitivity(sensitivity);
+    return c;
+  };
+
+  thread_local QCollator insensitive = make(Qt::CaseInsensitive);
+  thread_local QCollator sensitive   = make(Qt::CaseSensitive);
+
+  return cs == Qt::CaseInsensitive ? insensitive : sensitive;
 }
 
 int naturalCompare(const QString& a, const QString& b, Qt::CaseSensitivity cs)
 {
-  if (cs == Qt::CaseInsensitive) {
-    return naturalCompareI(a, b);
-  }
-
-  static QCollator c = [] {
-    QCollator temp;
-    temp.setNumericMode(true);
-    return temp;
-  }();
+  return naturalCollator(cs).compare(a, b);
+}
 
-  return c.compare(a, b);
+QCollatorSortKey naturalSortKey(const QString& s, Qt::CaseSensitivity cs)
+{
+  return naturalCollator(cs).sortKey(s);
 }
 
 struct CoTaskMemFreer
@@ -21,10 +21,46 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "versioninfo.h"
 #include <QRegularExpression>
 #include <QVersionNumber>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <tuple>
 
 namespace
 {
 const QRegularExpression VERSION_REGEX("^(\\d+)(\\.(\\d+))?(\\.(\\d+))?(\\.(\\d+))?");
+
+// decimal mark versions are compared as fixed-point numbers with this many decimals
+constexpr int DECIMAL_DIGITS         = 9;
+constexpr std::int64_t DECIMAL_SCALE = 1'000'000'000;
+
+// value of "major.minor" as a fixed-point number, where minor is right-justified with
+// zeros to the given number of positions, e.g., 1.5 with 2 positions is 1.05
+std::int64_t decimalValue(int major, int minor, int positions)
+{
+  if (minor < 0) {
+    // "1.-5" is not a number
+    return 0;
+  }
+
+  int digits = 1;
+  for (int m = minor; m >= 10; m /= 10) {
+    ++digits;
+  }
+  digits = std::max(digits, positions);
+
+  std::int64_t fraction = minor;
+  for (int i = digits; i < DECIMAL_DIGITS; ++i) {
+    fraction *= 10;
+  }
+  for (int i = DECIMAL_DIGITS; i < digits && fraction != 0; ++i) {
+    fraction /= 10;
+  }
+
+  const std::int64_t value =
+      std::abs(static_cast<std::int64_t>(major)) * DECIMAL_SCALE + fraction;
+  return major < 0 ? -value : value;
+}
 }
 
 namespace MOBase
@@ -330,101 +366,86 @@ void VersionInfo::parse(const QString& versionString, VersionScheme scheme,
   m_Valid = true;
 }
 
-QDLLEXPORT bool operator<(const VersionInfo& LHS, const VersionInfo& RHS)
+std::weak_ordering VersionInfo::compare(const VersionInfo& LHS, const VersionInfo& RHS)
 {
-  if (!LHS.isValid() && RHS.isValid())
-    return true;
-  if (!RHS.isValid() && LHS.isValid())
-    return false;
+  if (LHS.isValid() != RHS.isValid()) {
+    return LHS.isValid() ? std::weak_ordering::greater : std::weak_ordering::less;
+  }
 
   // date-releases are lower than regular versions
-  if ((LHS.m_Scheme == VersionInfo::SCHEME_DATE) &&
-      (RHS.m_Scheme != VersionInfo::SCHEME_DATE)) {
-    return true;
-  } else if ((LHS.m_Scheme != VersionInfo::SCHEME_DATE) &&
-             (RHS.m_Scheme == VersionInfo::SCHEME_DATE)) {
-    return false;
-  } else if ((LHS.m_Scheme == VersionInfo::SCHEME_DECIMALMARK) ||
-             (RHS.m_Scheme == VersionInfo::SCHEME_DECIMALMARK)) {
+  const bool LHS_date = LHS.m_Scheme == SCHEME_DATE;
+  const bool RHS_date = RHS.m_Scheme == SCHEME_DATE;
+  if (LHS_date != RHS_date) {
+    return LHS_date ? std::weak_ordering::less : std::weak_ordering::greater;
+  }
+
+  std::weak_ordering order = std::weak_ordering::equivalent;
+
+  if ((LHS.m_Scheme == SCHEME_DECIMALMARK) || (RHS.m_Scheme == SCHEME_DECIMALMARK)) {
     // use decimal versioning if either version is a decimal. The parser interprets
     // versions as regular if in doubt so if the scheme is "decimal" it is definitively
     // a decimal version number whereas SCHEME_REGULAR means "probably regular"
-
-    float leftVal = QString("%1.%2")
-                        .arg(LHS.m_Major)
-                        .arg(QString("%1")
-                                 .arg(LHS.m_Minor)
-                                 .rightJustified(LHS.m_DecimalPositions, '0'))
-                        .toFloat();
-    float rightVal = QString("%1.%2")
-                         .arg(RHS.m_Major)
-                         .arg(QString("%1")
-                                  .arg(RHS.m_Minor)
-                                  .rightJustified(RHS.m_DecimalPositions, '0'))
-                         .toFloat();
-    if (fabs(leftVal - rightVal) > 0.001f) {
-      return leftVal < rightVal;
-    }
+    order = decimalValue(LHS.m_Major, LHS.m_Minor, LHS.m_DecimalPositions) <=>
+            decimalValue(RHS.m_Major, RHS.m_Minor, RHS.m_DecimalPositions);
   } else {
     // if in doubt, use the sane choice. regular and numbers+letters can be treated the
     // same way
-    if (LHS.m_Major != RHS.m_Major)
-      return LHS.m_Major < RHS.m_Major;
-    if (LHS.m_Minor != RHS.m_Minor)
-      return LHS.m_Minor < RHS.m_Minor;
-    if (LHS.m_SubMinor != RHS.m_SubMinor)
-      return LHS.m_SubMinor < RHS.m_SubMinor;
-    if (LHS.m_SubSubMinor != RHS.m_SubSubMinor)
-      return LHS.m_SubSubMinor < RHS.m_SubSubMinor;
+    order = std::tie(LHS.m_Major, LHS.m_Minor, LHS.m_SubMinor, LHS.m_SubSubMinor) <=>
+            std::tie(RHS.m_Major, RHS.m_Minor, RHS.m_SubMinor, RHS.m_SubSubMinor);
+  }
+
+  if (order != 0) {
+    return order;
   }
 
   // subminor, release-type and rest are treated the same for all versioning schemes,
   // but on parsing they may still differ, i.e. a b-suffix is only interpreted to mean
   // "beta" in the regular scheme
-  if (LHS.m_ReleaseType != RHS.m_ReleaseType)
-    return LHS.m_ReleaseType < RHS.m_ReleaseType;
+  if (LHS.m_ReleaseType != RHS.m_ReleaseType) {
+    return LHS.m_ReleaseType < RHS.m_ReleaseType ? std::weak_ordering::less
+                                                 : std::weak_ordering::greater;
+  }
 
   // if the rest contains only integers, compare them numerically
   bool LHS_ok, RHS_ok;
-  int LHS_int, RHS_int;
-  LHS_int = LHS.m_Rest.toInt(&LHS_ok);
-  RHS_int = RHS.m_Rest.toInt(&RHS_ok);
+  const int LHS_int = LHS.m_Rest.toInt(&LHS_ok);
+  const int RHS_int = RHS.m_Rest.toInt(&RHS_ok);
   if (LHS_ok && RHS_ok) {
-    return LHS_int < RHS_int;
+    return LHS_int <=> RHS_int;
   }
 
   // give up and compare lexically
-  return LHS.m_Rest < RHS.m_Rest;
+  return QString::compare(LHS.m_Rest, RHS.m_Rest) <=> 0;
+}
+
+QDLLEXPORT bool operator<(const VersionInfo& LHS, const VersionInfo& RHS)
+{
+  return VersionInfo::compare(LHS, RHS) < 0;
 }
 
 QDLLEXPORT bool operator>(const VersionInfo& LHS, const VersionInfo& RHS)
 {
-  return !(LHS <= RHS);
+  return VersionInfo::compare(LHS, RHS) > 0;
 }
 
 QDLLEXPORT bool operator<=(const VersionInfo& LHS, const VersionInfo& RHS)
 {
-  // TODO not exactly optimized...
-  if (LHS < RHS) {
-    return true;
-  } else {
-    return !(RHS < LHS);
-  }
+  return VersionInfo::compare(LHS, RHS) <= 0;
 }
 
 QDLLEXPORT bool operator>=(const VersionInfo& LHS, const VersionInfo& RHS)
 {
-  return RHS <= LHS;
+  return VersionInfo::compare(LHS, RHS) >= 0;
 }
 
 QDLLEXPORT bool operator!=(const VersionInfo& LHS, const VersionInfo& RHS)
 {
-  return (LHS < RHS) || (RHS < LHS);
+  return VersionInfo::compare(LHS, RHS) != 0;
 }
 
 QDLLEXPORT bool operator==(const VersionInfo& LHS, const VersionInfo& RHS)
 {
-  return !(LHS < RHS) && !(RHS < LHS);
+  return VersionInfo::compare(LHS, RHS) == 0;
 }
 
 }  // namespace MOBase
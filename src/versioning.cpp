@@ -1,27 +1,26 @@
 #include "versioning.h"
 
-#include <QRegularExpression>
+#include <QStringView>
+#include <algorithm>
+#include <cstdint>
 #include <format>
-#include <unordered_map>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <utility>
 
 #include "formatters.h"
 
-// official semver regex
-static const QRegularExpression s_SemVerStrictRegEx{
-    R"(^(?P<major>0|[1-9]\d*)\.(?P<minor>0|[1-9]\d*)\.(?P<patch>0|[1-9]\d*)(?:-(?P<prerelease>(?:0|[1-9]\d*|\d*[a-zA-Z-][0-9a-zA-Z-]*)(?:\.(?:0|[1-9]\d*|\d*[a-zA-Z-][0-9a-zA-Z-]*))*))?(?:\+(?P<buildmetadata>[0-9a-zA-Z-]+(?:\.[0-9a-zA-Z-]+)*))?$)"};
-
-// for MO2, to match stuff like 1.2.3rc1 or v1.2.3a1+XXX
-static const QRegularExpression s_SemVerMO2RegEx{
-    R"(^v?(?P<major>0|[1-9]\d*)\.(?P<minor>0|[1-9]\d*)\.(?P<patch>0|[1-9]\d*)(?:\.(?P<subpatch>0|[1-9]\d*))?(?:(?P<type>dev|a|alpha|b|beta|rc)(?P<prerelease>0|[1-9](?:[.0-9])*))?(?:\+(?P<buildmetadata>[0-9a-zA-Z-]+(?:\.[0-9a-zA-Z-]+)*))?$)"};
-
 // match from value to release type
-static const std::unordered_map<QString, MOBase::Version::ReleaseType>
-    s_StringToRelease{{"dev", MOBase::Version::Development},
-                      {"alpha", MOBase::Version::Alpha},
-                      {"a", MOBase::Version::Alpha},
-                      {"beta", MOBase::Version::Beta},
-                      {"b", MOBase::Version::Beta},
-                      {"rc", MOBase::Version::ReleaseCandidate}};
+static constexpr std::pair<std::u16string_view, MOBase::Version::ReleaseType>
+    s_StringToRelease[]{{u"dev", MOBase::Version::Development},
+                        {u"alpha", MOBase::Version::Alpha},
+                        {u"a", MOBase::Version::Alpha},
+                        {u"beta", MOBase::Version::Beta},
+                        {u"b", MOBase::Version::Beta},
+                        {u"rc", MOBase::Version::ReleaseCandidate}};
 
 namespace MOBase
 {
@@ -29,87 +28,365 @@ namespace MOBase
 namespace
 {
 
-  Version parseVersionSemVer(QString const& value)
+  constexpr bool isDigit(char16_t c) { return c >= u'0' && c <= u'9'; }
+
+  // release type with the given name, case-insensitive
+  //
+  std::optional<Version::ReleaseType> toReleaseType(QStringView s)
   {
-    const auto match = s_SemVerStrictRegEx.match(value);
+    for (const auto& [name, type] : s_StringToRelease) {
+      if (s.compare(QStringView(name), Qt::CaseInsensitive) == 0) {
+        return type;
+      }
+    }
 
-    if (!match.hasMatch()) {
-      throw InvalidVersionException(
-          QString::fromStdString(std::format("invalid version string: '{}'", value)));
+    return {};
+  }
+
+  constexpr bool isLower(char16_t c) { return c >= u'a' && c <= u'z'; }
+
+  constexpr bool isIdentifier(char16_t c)
+  {
+    return isDigit(c) || isLower(c) || (c >= u'A' && c <= u'Z') || c == u'-';
+  }
+
+  // same as QString::toInt(), i.e., an optional minus sign followed by digits, or
+  // nothing if the value does not fit in an int
+  //
+  std::optional<int> toInt(QStringView s)
+  {
+    const bool negative = s.startsWith(u'-');
+    if (negative) {
+      s = s.mid(1);
     }
 
-    const auto major = match.captured("major").toInt();
-    const auto minor = match.captured("minor").toInt();
-    const auto patch = match.captured("patch").toInt();
-
-    std::vector<std::variant<int, Version::ReleaseType>> prereleases;
-    for (auto& part : match.captured("prerelease")
-                          .split(".", Qt::SplitBehaviorFlags::SkipEmptyParts)) {
-      // try to extract an int
-      bool ok             = true;
-      const auto intValue = part.toInt(&ok);
-      if (ok) {
-        prereleases.push_back(intValue);
-        continue;
-      }
+    if (s.isEmpty()) {
+      return {};
+    }
 
-      // check if we have a valid prerelease type
-      const auto it = s_StringToRelease.find(part.toLower());
-      if (it == s_StringToRelease.end()) {
-        throw InvalidVersionException(
-            QString::fromStdString(std::format("invalid prerelease type: '{}'", part)));
+    constexpr std::int64_t limit = std::int64_t(std::numeric_limits<int>::max()) + 1;
+
+    std::int64_t value = 0;
+    for (const auto c : s) {
+      if (!isDigit(c.unicode())) {
+        return {};
       }
 
-      prereleases.push_back(it->second);
+      value = value * 10 + (c.unicode() - u'0');
+      if (value > limit) {
+        return {};
+      }
     }
 
-    const auto buildMetadata = match.captured("buildmetadata").trimmed();
+    value = negative ? -value : value;
+    if (value > std::numeric_limits<int>::max()) {
+      return {};
+    }
 
-    return Version(major, minor, patch, 0, prereleases, buildMetadata);
+    return static_cast<int>(value);
   }
 
-  Version parseVersionMO2(QString const& value)
+  // single-pass parser for both modes, equivalent to the following regular
+  // expressions (SemVer is the official one) followed by the conversion of the
+  // captured groups:
+  //
+  // SemVer: ^(0|[1-9]\d*)\.(0|[1-9]\d*)\.(0|[1-9]\d*)
+  //          (?:-((?:0|[1-9]\d*|\d*[a-zA-Z-][0-9a-zA-Z-]*)
+  //               (?:\.(?:0|[1-9]\d*|\d*[a-zA-Z-][0-9a-zA-Z-]*))*))?
+  //          (?:\+([0-9a-zA-Z-]+(?:\.[0-9a-zA-Z-]+)*))?$
+  //
+  // MO2:    ^v?(0|[1-9]\d*)\.(0|[1-9]\d*)\.(0|[1-9]\d*)(?:\.(0|[1-9]\d*))?
+  //          (?:(dev|a|alpha|b|beta|rc)(0|[1-9](?:[.0-9])*))?
+  //          (?:\+([0-9a-zA-Z-]+(?:\.[0-9a-zA-Z-]+)*))?$
+  //
+  // like $, the end of the string may be preceded by a single line feed
+  //
+  class VersionParser
   {
-    const auto match = s_SemVerMO2RegEx.match(value);
+  public:
+    VersionParser(QStringView value) : m_value(value) {}
+
+    Version parseSemVer()
+    {
+      const auto [major, minor, patch] = numbers();
+
+      std::vector<Version::PreRelease> prereleases;
+
+      // unknown pre-release types are only reported if the whole string is valid
+      QStringView invalid;
+
+      if (consume(u'-')) {
+        do {
+          const auto part = identifier();
+
+          // 0|[1-9]\d*|\d*[a-zA-Z-][0-9a-zA-Z-]*, i.e., anything but numbers with
+          // leading zeros
+          if (part.isEmpty() ||
+              (part.size() > 1 && part.front() == u'0' &&
+               std::all_of(part.begin(), part.end(), [](QChar c) {
+                 return isDigit(c.unicode());
+               }))) {
+            fail();
+          }
+
+          if (const auto value = toInt(part)) {
+            prereleases.push_back(*value);
+          } else if (const auto type = toReleaseType(part)) {
+            prereleases.push_back(*type);
+          } else if (invalid.isNull()) {
+            invalid = part;
+          }
+        } while (consume(u'.'));
+      }
+
+      auto metadata = buildMetadata();
 
-    if (!match.hasMatch()) {
-      throw InvalidVersionException(
-          QString::fromStdString(std::format("invalid version string: '{}'", value)));
+      if (!invalid.isNull()) {
+        throw InvalidVersionException(QString::fromStdString(
+            std::format("invalid prerelease type: '{}'", invalid)));
+      }
+
+      return Version(major, minor, patch, 0, std::move(prereleases),
+                     std::move(metadata));
     }
 
-    const auto major = match.captured("major").toInt();
-    const auto minor = match.captured("minor").toInt();
-    const auto patch = match.captured("patch").toInt();
+    Version parseMO2()
+    {
+      consume(u'v');
 
-    const auto subpatch = match.captured("subpatch").toInt();
+      const auto [major, minor, patch] = numbers();
+      const auto subpatch              = consume(u'.') ? number() : 0;
 
-    // unlike semver, the regex will only match valid values
-    std::vector<std::variant<int, Version::ReleaseType>> prereleases;
-    if (match.hasCaptured("type")) {
-      prereleases.push_back(s_StringToRelease.at(match.captured("type")));
+      std::vector<Version::PreRelease> prereleases;
 
-      // for version with decimal point, e.g., 2.4.1rc1.1, we split the components into
-      // pre-release components to get {rc, 1, 1} - this works fine since {rc, 1} < {rc,
-      // 1, 1}
-      //
-      for (const auto& preVersion :
-           match.captured("prerelease").split(".", Qt::SkipEmptyParts)) {
-        prereleases.push_back(preVersion.toInt());
+      const auto start = m_pos;
+      while (m_pos < m_value.size() && isLower(current())) {
+        ++m_pos;
       }
+
+      if (m_pos != start) {
+        const auto type = toReleaseType(m_value.sliced(start, m_pos - start));
+        if (!type || !isDigit(current())) {
+          fail();
+        }
+
+        prereleases.push_back(*type);
+
+        // 0|[1-9](?:[.0-9])*
+        //
+        // for version with decimal point, e.g., 2.4.1rc1.1, the components are split
+        // into pre-release components to get {rc, 1, 1} - this works fine since {rc,
+        // 1} < {rc, 1, 1}
+        //
+        if (consume(u'0')) {
+          prereleases.push_back(0);
+        } else {
+          while (m_pos < m_value.size() &&
+                 (isDigit(current()) || current() == u'.')) {
+            const auto begin = m_pos;
+            while (m_pos < m_value.size() && isDigit(current())) {
+              ++m_pos;
+            }
+
+            if (m_pos != begin) {
+              prereleases.push_back(
+                  toInt(m_value.sliced(begin, m_pos - begin)).value_or(0));
+            } else {
+              ++m_pos;
+            }
+          }
+        }
+      }
+
+      auto metadata = buildMetadata();
+
+      return Version(major, minor, patch, subpatch, std::move(prereleases),
+                     std::move(metadata));
     }
 
-    const auto buildMetadata = match.captured("buildmetadata").trimmed();
+  private:
+    QStringView m_value;
+    qsizetype m_pos = 0;
 
-    return Version(major, minor, patch, subpatch, prereleases, buildMetadata);
-  }
+    [[noreturn]] void fail() const
+    {
+      throw InvalidVersionException(QString::fromStdString(
+          std::format("invalid version string: '{}'", m_value)));
+    }
+
+    // current character, or 0 at the end
+    char16_t current() const
+    {
+      return m_pos < m_value.size() ? m_value[m_pos].unicode() : u'\0';
+    }
+
+    bool consume(char16_t c)
+    {
+      if (m_pos < m_value.size() && current() == c) {
+        ++m_pos;
+        return true;
+      }
+
+      return false;
+    }
+
+    // 0|[1-9]\d*, with the value of QString::toInt(), i.e., 0 on overflow
+    //
+    int number()
+    {
+      const auto start = m_pos;
+
+      if (!consume(u'0')) {
+        while (m_pos < m_value.size() && isDigit(current())) {
+          ++m_pos;
+        }
+
+        if (m_pos == start) {
+          fail();
+        }
+      }
+
+      return toInt(m_value.sliced(start, m_pos - start)).value_or(0);
+    }
+
+    std::tuple<int, int, int> numbers()
+    {
+      const auto major = number();
+      expect(u'.');
+      const auto minor = number();
+      expect(u'.');
+      const auto patch = number();
+
+      return {major, minor, patch};
+    }
+
+    void expect(char16_t c)
+    {
+      if (!consume(c)) {
+        fail();
+      }
+    }
+
+    // [0-9a-zA-Z-]*
+    //
+    QStringView identifier()
+    {
+      const auto start = m_pos;
+      while (m_pos < m_value.size() && isIdentifier(current())) {
+        ++m_pos;
+      }
+
+      return m_value.sliced(start, m_pos - start);
+    }
+
+    // (?:\+([0-9a-zA-Z-]+(?:\.[0-9a-zA-Z-]+)*))?$
+    //
+    QString buildMetadata()
+    {
+      QStringView metadata;
+
+      if (consume(u'+')) {
+        const auto start = m_pos;
+        do {
+          if (identifier().isEmpty()) {
+            fail();
+          }
+        } while (consume(u'.'));
+
+        metadata = m_value.sliced(start, m_pos - start);
+      }
+
+      consume(u'\n');
+      if (m_pos != m_value.size()) {
+        fail();
+      }
+
+      return metadata.toString();
+    }
+  };
 
 }  // namespace
 
 Version Version::parse(QString const& value, ParseMode mode)
 {
-  return mode == ParseMode::SemVer ? parseVersionSemVer(value) : parseVersionMO2(value);
+  VersionParser parser(value);
+  return mode == ParseMode::SemVer ? parser.parseSemVer() : parser.parseMO2();
 }
 
+namespace
+{
+  // layout of the sort key, from the most significant bits
+  // - major, minor and patch on 12 bits each, sub-patch on 8 bits,
+  // - one bit set for releases, so that they come after their pre-releases,
+  // - for pre-releases, the release type on 2 bits followed by up to two numbers on 9
+  //   and 8 bits, e.g., rc1 or beta.2.1
+  //
+  // anything else (larger numbers, pre-releases starting with a number or with a
+  // release type after a number, etc.) has no key
+  //
+  constexpr int MajorBits = 12, MinorBits = 12, PatchBits = 12, SubPatchBits = 8;
+  constexpr int ReleaseBits = 1, TypeBits = 2;
+  constexpr int PreReleaseBits[] = {9, 8};
+
+  constexpr bool fitsIn(int value, int bits)
+  {
+    return value >= 0 && value < (1 << bits);
+  }
+
+  std::optional<std::uint64_t> makeSortKey(int major, int minor, int patch,
+                                           int subpatch,
+                                           std::span<const Version::PreRelease> pre)
+  {
+    if (!fitsIn(major, MajorBits) || !fitsIn(minor, MinorBits) ||
+        !fitsIn(patch, PatchBits) || !fitsIn(subpatch, SubPatchBits)) {
+      return {};
+    }
+
+    std::uint64_t key = static_cast<std::uint64_t>(major);
+    key               = (key << MinorBits) | static_cast<std::uint64_t>(minor);
+    key               = (key << PatchBits) | static_cast<std::uint64_t>(patch);
+    key               = (key << SubPatchBits) | static_cast<std::uint64_t>(subpatch);
+
+    // trailing zeros are ignored by the comparison, e.g., rc1.0 is rc1
+    while (pre.size() > 1 && std::holds_alternative<int>(pre.back()) &&
+           std::get<int>(pre.back()) == 0) {
+      pre = pre.first(pre.size() - 1);
+    }
+
+    if (pre.empty()) {
+      key = (key << ReleaseBits) | 1;
+      return key << (TypeBits + PreReleaseBits[0] + PreReleaseBits[1]);
+    }
+
+    const auto* type = std::get_if<Version::ReleaseType>(&pre.front());
+    if (!type || !fitsIn(static_cast<int>(*type), TypeBits) ||
+        pre.size() > 1 + std::size(PreReleaseBits)) {
+      return {};
+    }
+
+    key = (key << ReleaseBits);
+    key = (key << TypeBits) | static_cast<std::uint64_t>(*type);
+
+    // missing numbers are zeros, which is also how the comparison handles them
+    for (std::size_t i = 0; i < std::size(PreReleaseBits); ++i) {
+      int value = 0;
+
+      if (i + 1 < pre.size()) {
+        const auto* number = std::get_if<int>(&pre[i + 1]);
+        if (!number || !fitsIn(*number, PreReleaseBits[i])) {
+          return {};
+        }
+        value = *number;
+      }
+
+      key = (key << PreReleaseBits[i]) | static_cast<std::uint64_t>(value);
+    }
+
+    return key;
+  }
+
+}  // namespace
+
 // constructors
 
 Version::Version(int major, int minor, int patch, QString metadata)
@@ -139,12 +416,18 @@ Version::Version(int major, int minor, int patch, int subpatch, ReleaseType type
 {}
 
 Version::Version(int major, int minor, int patch, int subpatch,
-                 std::vector<std::variant<int, ReleaseType>> prereleases,
-                 QString metadata)
+                 std::vector<PreRelease> prereleases, QString metadata)
     : m_Major{major}, m_Minor{minor}, m_Patch{patch}, m_SubPatch{subpatch},
       m_PreReleases{std::move(prereleases)}, m_BuildMetadata{std::move(metadata)}
 {}
 
+// sort key
+
+std::optional<std::uint64_t> Version::sortKey() const
+{
+  return makeSortKey(m_Major, m_Minor, m_Patch, m_SubPatch, m_PreReleases);
+}
+
 // string
 
 QString Version::string(const FormatModes& modes) const
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string_view>
+
+// small helpers for the uibase-bench executable - benchmarks are plain functions
+// registered in bench_main.cpp that print their results with report()
+namespace Bench
+{
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief Run the given function once and return the elapsed time in seconds.
+ */
+template <class Fn>
+double measure(Fn&& fn)
+{
+  const auto start = Clock::now();
+  fn();
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * @brief Print the throughput of a benchmark.
+ *
+ * @param name Name of the benchmark.
+ * @param operations Number of operations performed.
+ * @param seconds Time taken by all the operations.
+ */
+inline void report(std::string_view name, std::size_t operations, double seconds)
+{
+  std::printf("%-48.*s %12.0f ops/s %10.3f ms\n", static_cast<int>(name.size()),
+              name.data(), seconds > 0 ? operations / seconds : 0.0, seconds * 1000);
+}
+
+/**
+ * @brief Print an arbitrary value measured by a benchmark.
+ */
+inline void report(std::string_view name, double value, std::string_view unit)
+{
+  std::printf("%-48.*s %12.1f %.*s\n", static_cast<int>(name.size()), name.data(),
+              value, static_cast<int>(unit.size()), unit.data());
+}
+
+/**
+ * @brief Prevent the compiler from optimizing away the computation of a value.
+ */
+template <class T>
+void doNotOptimize(T const& value)
+{
+  static const void* volatile sink;
+  sink = &value;
+}
+
+}  // namespace Bench
@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <uibase/ifiletree.h>
+
+#include "bench.h"
+
+using namespace MOBase;
+
+namespace
+{
+
+// Directory layout of a synthetic tree, shared by all the directories of the tree so
+// that directories can be populated lazily, as plugin trees are.
+struct Layout
+{
+  struct Directory
+  {
+    QString name;
+    std::vector<std::size_t> directories;
+    std::vector<QString> files;
+  };
+
+  // index 0 is the root
+  std::vector<Directory> directories;
+  std::size_t entries = 0;
+
+  // a sample of file paths, used for lookups
+  std::vector<QString> samples;
+};
+
+// Generate a layout looking like a set of mod archives: a few top-level folders per
+// mod, mostly single-child chains at the top (Data/textures/actors/...) and a wide
+// fan-out of files at the bottom.
+std::shared_ptr<const Layout> makeLayout(std::size_t entries, unsigned seed)
+{
+  static const char* const folders[] = {"meshes",  "textures", "actors", "character",
+                                        "armor",   "weapons",  "sound",  "fx",
+                                        "scripts", "interface"};
+  static const char* const extensions[] = {".nif", ".dds", ".hkx", ".wav",
+                                           ".pex", ".esp", ".txt"};
+
+  std::mt19937 rng(seed);
+  std::geometric_distribution<int> fileCount(0.1);
+  std::discrete_distribution<int> dirCount({30, 45, 15, 7, 3});
+
+  auto layout = std::make_shared<Layout>();
+  layout->directories.push_back({});
+
+  struct Pending
+  {
+    std::size_t index;
+    std::size_t depth;
+    QString path;
+  };
+  std::vector<Pending> pending;
+
+  const auto addDirectory = [&](Pending const& parent, QString name) {
+    const auto index = layout->directories.size();
+    layout->directories.push_back({name, {}, {}});
+    layout->directories[parent.index].directories.push_back(index);
+    ++layout->entries;
+    pending.push_back({index, parent.depth + 1, parent.path + name + "/"});
+  };
+
+  // one top-level directory per ~2000 entries, i.e., per mod
+  const Pending root{0, 0, ""};
+  for (std::size_t i = 0; i < std::max<std::size_t>(1, entries / 2000); ++i) {
+    addDirectory(root, QString("mod%1").arg(i));
+  }
+
+  for (std::size_t p = 0; p < pending.size() && layout->entries < entries; ++p) {
+    const auto current = pending[p];
+
+    const int ndirs = current.depth < 8 ? dirCount(rng) : 0;
+    for (int i = 0; i < ndirs; ++i) {
+      addDirectory(current, QString("%1%2").arg(folders[rng() % std::size(folders)])
+                                .arg(i));
+    }
+
+    const int nfiles = current.depth > 1 ? fileCount(rng) : 0;
+    for (int i = 0; i < nfiles && layout->entries < entries; ++i) {
+      auto name =
+          QString("file%1%2").arg(i).arg(extensions[rng() % std::size(extensions)]);
+      if (rng() % 64 == 0) {
+        layout->samples.push_back(current.path + name);
+      }
+      layout->directories[current.index].files.push_back(std::move(name));
+      ++layout->entries;
+    }
+
+    // keep the generation going if the tree is not large enough yet
+    if (p + 1 == pending.size() && layout->entries < entries) {
+      const auto mods = layout->directories[0].directories.size();
+      addDirectory(root, QString("mod%1").arg(mods));
+    }
+  }
+
+  return layout;
+}
+
+class SyntheticTree : public IFileTree
+{
+public:
+  static std::shared_ptr<IFileTree> makeTree(std::shared_ptr<const Layout> layout)
+  {
+    return std::shared_ptr<SyntheticTree>(
+        new SyntheticTree(nullptr, "", std::move(layout), 0));
+  }
+
+protected:
+  SyntheticTree(std::shared_ptr<const IFileTree> parent, QString name,
+                std::shared_ptr<const Layout> layout, std::size_t index)
+      : FileTreeEntry(parent, name), IFileTree(), m_Layout(std::move(layout)),
+        m_Index(index)
+  {}
+
+  std::shared_ptr<IFileTree> makeDirectory(std::shared_ptr<const IFileTree> parent,
+                                           QString name) const override
+  {
+    return std::shared_ptr<SyntheticTree>(
+        new SyntheticTree(parent, name, nullptr, 0));
+  }
+
+  bool doPopulate(std::shared_ptr<const IFileTree> parent,
+                  std::vector<std::shared_ptr<FileTreeEntry>>& entries) const override
+  {
+    if (m_Layout == nullptr) {
+      return true;
+    }
+
+    auto& directory = m_Layout->directories[m_Index];
+    entries.reserve(directory.directories.size() + directory.files.size());
+    for (auto index : directory.directories) {
+      entries.push_back(std::shared_ptr<SyntheticTree>(new SyntheticTree(
+          parent, m_Layout->directories[index].name, m_Layout, index)));
+    }
+    for (auto& file : directory.files) {
+      entries.push_back(makeFile(parent, file));
+    }
+
+    // the layout is not sorted, as for most archive formats
+    return false;
+  }
+
+  std::shared_ptr<IFileTree> doClone() const override
+  {
+    return std::shared_ptr<SyntheticTree>(
+        new SyntheticTree(nullptr, name(), m_Layout, m_Index));
+  }
+
+private:
+  std::shared_ptr<const Layout> m_Layout;
+  std::size_t m_Index;
+};
+
+// walk the whole tree, populating it
+std::size_t populateAll(std::shared_ptr<const IFileTree> tree)
+{
+  std::size_t count = 0;
+  for (auto entry : *tree) {
+    ++count;
+    if (entry->isDir()) {
+      count += populateAll(entry->astree());
+    }
+  }
+  return count;
+}
+
+void benchSize(std::size_t size)
+{
+  const auto prefix = std::to_string(size) + " entries: ";
+  const auto layout = makeLayout(size, 42);
+
+  auto tree         = SyntheticTree::makeTree(layout);
+  std::size_t count = 0;
+  Bench::report(prefix + "populate", layout->entries, Bench::measure([&] {
+                  count = populateAll(tree);
+                }));
+
+  const auto usage = tree->memoryUsage();
+  Bench::report(prefix + "memory", usage.total() / 1024.0 / 1024.0, "MiB");
+  Bench::report(prefix + "bytes per entry", double(usage.total()) / count, "B");
+  Bench::report(prefix + "  nodes", double(usage.nodes) / count, "B");
+  Bench::report(prefix + "  names", double(usage.names) / count, "B");
+  Bench::report(prefix + "  children", double(usage.children) / count, "B");
+  Bench::report(prefix + "  control blocks", double(usage.controlBlocks) / count, "B");
+
+  std::size_t found = 0;
+  Bench::report(prefix + "find", layout->samples.size(), Bench::measure([&] {
+                  for (auto& path : layout->samples) {
+                    found += tree->find(path) != nullptr;
+                  }
+                }));
+  Bench::doNotOptimize(found);
+
+  std::size_t walked = 0;
+  Bench::report(prefix + "walk", count, Bench::measure([&] {
+                  tree->walk([&walked](QString const&, auto const&) {
+                    ++walked;
+                    return IFileTree::WalkReturn::CONTINUE;
+                  });
+                }));
+  Bench::doNotOptimize(walked);
+
+#ifdef __cpp_lib_generator
+  std::size_t globbed = 0;
+  Bench::report(prefix + "glob **/*.dds", count, Bench::measure([&] {
+                  for (auto entry : glob(tree, "**/*.dds")) {
+                    globbed += entry != nullptr;
+                  }
+                }));
+  Bench::doNotOptimize(globbed);
+#endif
+
+  // merge a tree of a tenth of the size with partially overlapping mods
+  auto source = SyntheticTree::makeTree(makeLayout(size / 10, 43));
+  const auto sourceCount = populateAll(source);
+  std::size_t overwritten = 0;
+  Bench::report(prefix + "merge", sourceCount, Bench::measure([&] {
+                  overwritten = tree->merge(source);
+                }));
+  Bench::doNotOptimize(overwritten);
+}
+
+// erase and insert entries repeatedly in a single large directory, where every
+// operation moves the following entries of the directory
+void benchLargeDirectory(std::size_t size, std::size_t changed)
+{
+  const auto prefix = std::to_string(size) + " entries in one directory: ";
+
+  auto layout = std::make_shared<Layout>();
+  layout->directories.push_back({});
+  for (std::size_t i = 0; i < size; ++i) {
+    layout->directories[0].files.push_back(QString("file%1.dds").arg(i));
+  }
+  layout->entries = size;
+
+  auto tree = SyntheticTree::makeTree(layout);
+  populateAll(tree);
+
+  std::vector<std::shared_ptr<FileTreeEntry>> entries;
+  for (std::size_t i = 0; i < changed; ++i) {
+    entries.push_back(tree->find(QString("file%1.dds").arg(i * size / changed)));
+  }
+
+  Bench::report(prefix + "erase", changed, Bench::measure([&] {
+                  for (auto& entry : entries) {
+                    tree->erase(entry);
+                  }
+                }));
+
+  Bench::report(prefix + "insert", changed, Bench::measure([&] {
+                  for (auto& entry : entries) {
+                    tree->insert(entry);
+                  }
+                }));
+
+  Bench::report(prefix + "removeEntries", changed, Bench::measure([&] {
+                  tree->removeEntries(entries);
+                }));
+
+  for (auto& entry : entries) {
+    tree->insert(entry);
+  }
+
+  const auto restored = tree->size();
+  Bench::doNotOptimize(restored);
+}
+
+}  // namespace
+
+void benchIFileTree()
+{
+  for (std::size_t size : {1'000, 10'000, 100'000, 1'000'000, 5'000'000}) {
+    benchSize(size);
+  }
+
+  benchLargeDirectory(50'000, 5'000);
+}
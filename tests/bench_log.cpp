@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <latch>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Windows.h>
+
+#include <uibase/log.h>
+
+#include "bench.h"
+
+using namespace MOBase;
+
+namespace
+{
+
+// messages logged by each run, split between the threads
+constexpr std::size_t MessagesPerRun = 200'000;
+
+enum class Sink
+{
+  Null,
+  Callback,
+  ViewCallback,
+  File
+};
+
+struct Scenario
+{
+  std::string name;
+  Sink sink;
+  bool blacklist;
+
+  // level of the messages, the logger is at Info
+  log::Levels level;
+};
+
+// the console sink is only created when stderr is a console, so stderr is hidden
+// while the logger is created to only measure the sinks of the scenario
+std::unique_ptr<log::Logger> makeLogger()
+{
+  const auto err = ::GetStdHandle(STD_ERROR_HANDLE);
+  const auto nul = ::CreateFileW(L"NUL", GENERIC_WRITE, FILE_SHARE_WRITE, nullptr,
+                                 OPEN_EXISTING, 0, nullptr);
+
+  ::SetStdHandle(STD_ERROR_HANDLE, nul);
+
+  auto logger = std::make_unique<log::Logger>(
+      log::LoggerConfiguration{.name     = "bench",
+                               .maxLevel = log::Info,
+                               .pattern  = "[%Y-%m-%d %H:%M:%S.%e] [%L] %v"});
+
+  ::SetStdHandle(STD_ERROR_HANDLE, err);
+  ::CloseHandle(nul);
+
+  return logger;
+}
+
+double percentile(std::vector<std::uint32_t>& values, double p)
+{
+  if (values.empty()) {
+    return 0;
+  }
+
+  const auto n = static_cast<std::size_t>(p * static_cast<double>(values.size() - 1));
+  std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(n),
+                   values.end());
+  return values[n];
+}
+
+void run(const Scenario& s, std::size_t threadCount)
+{
+  const auto file = std::filesystem::temp_directory_path() / "uibase-bench-log.log";
+
+  auto logger = makeLogger();
+
+  switch (s.sink) {
+  case Sink::Null:
+    break;
+
+  case Sink::Callback:
+    logger->setCallback([](log::Entry e) {
+      Bench::doNotOptimize(e);
+    });
+    break;
+
+  case Sink::ViewCallback:
+    logger->setViewCallback([](const log::EntryView& e) {
+      Bench::doNotOptimize(e);
+    });
+    break;
+
+  case Sink::File:
+    logger->setFile(log::File::single(file));
+    break;
+  }
+
+  if (s.blacklist) {
+    for (int i = 0; i < 10; ++i) {
+      logger->addToBlacklist("C:\\Users\\user" + std::to_string(i), "%USERNAME%");
+    }
+  }
+
+  const std::size_t perThread = MessagesPerRun / threadCount;
+  const auto path =
+      QString::fromUtf8("C:\\Users\\user3\\AppData\\Local\\ModOrganizer");
+
+  // latency of each call, in nanoseconds
+  std::vector<std::vector<std::uint32_t>> latencies(threadCount);
+  std::latch start(static_cast<std::ptrdiff_t>(threadCount + 1));
+  std::vector<std::thread> threads;
+
+  for (std::size_t t = 0; t < threadCount; ++t) {
+    threads.emplace_back([&, t] {
+      auto& lat = latencies[t];
+      lat.reserve(perThread);
+
+      start.arrive_and_wait();
+
+      for (std::size_t i = 0; i < perThread; ++i) {
+        const auto before = Bench::Clock::now();
+        logger->log(s.level, "loading plugin {} from '{}' ({} bytes)", i, path,
+                    i * 1024);
+        const auto after = Bench::Clock::now();
+
+        lat.push_back(static_cast<std::uint32_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(after - before)
+                .count()));
+      }
+    });
+  }
+
+  const auto seconds = Bench::measure([&] {
+    start.arrive_and_wait();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  });
+
+  logger.reset();
+  std::filesystem::remove(file);
+
+  std::vector<std::uint32_t> all;
+  for (auto& lat : latencies) {
+    all.insert(all.end(), lat.begin(), lat.end());
+  }
+
+  const auto prefix = s.name + " " + std::to_string(threadCount) + "t ";
+  Bench::report(prefix + "throughput", perThread * threadCount, seconds);
+  Bench::report(prefix + "p50", percentile(all, 0.50), "ns");
+  Bench::report(prefix + "p99", percentile(all, 0.99), "ns");
+}
+
+}  // namespace
+
+void benchLog()
+{
+  const Scenario scenarios[] = {
+      {"null", Sink::Null, false, log::Info},
+      {"null blacklist", Sink::Null, true, log::Info},
+      {"callback", Sink::Callback, false, log::Info},
+      {"view callback", Sink::ViewCallback, false, log::Info},
+      {"file", Sink::File, false, log::Info},
+      {"file blacklist", Sink::File, true, log::Info},
+      {"disabled level", Sink::File, false, log::Debug},
+  };
+
+  for (const auto& s : scenarios) {
+    for (std::size_t threads : {1, 2, 4, 8, 16}) {
+      run(s, threads);
+    }
+  }
+}
@@ -0,0 +1,36 @@
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+// benchmark suites, defined in the bench_*.cpp files
+void benchIFileTree();
+void benchLog();
+void benchVersioning();
+
+int main(int argc, char** argv)
+{
+  struct Suite
+  {
+    std::string_view name;
+    void (*run)();
+  };
+
+  const Suite suites[] = {{"ifiletree", &benchIFileTree},
+                          {"log", &benchLog},
+                          {"versioning", &benchVersioning}};
+
+  // optional argument: only run suites whose name contains it
+  const std::string filter = argc > 1 ? argv[1] : "";
+
+  for (const auto& suite : suites) {
+    if (suite.name.find(filter) == std::string_view::npos) {
+      continue;
+    }
+
+    std::printf("== %.*s\n", static_cast<int>(suite.name.size()), suite.name.data());
+    suite.run();
+    std::printf("\n");
+  }
+
+  return 0;
+}
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <QString>
+
+#include <uibase/versioninfo.h>
+#include <uibase/versioning.h>
+
+#include "bench.h"
+
+using namespace MOBase;
+
+namespace
+{
+
+// number of versions parsed by each run
+constexpr std::size_t VersionCount = 200'000;
+
+// version strings looking like the ones of plugins and mods, valid in both modes
+std::vector<QString> makeVersions(Version::ParseMode mode, unsigned seed)
+{
+  static const char* const semVerSuffixes[] = {
+      "", "", "", "-alpha", "-beta.2", "-rc.1", "-dev.13", "+build.5"};
+  static const char* const mo2Suffixes[] = {"",      "",    "",      "a1",
+                                            "beta2", "rc1", "dev13", "rc1.1"};
+
+  const std::span<const char* const> suffixes =
+      mode == Version::ParseMode::SemVer ? std::span<const char* const>(semVerSuffixes)
+                                         : std::span<const char* const>(mo2Suffixes);
+
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> number(0, 30);
+  std::uniform_int_distribution<std::size_t> suffix(0, suffixes.size() - 1);
+
+  std::vector<QString> versions;
+  versions.reserve(VersionCount);
+
+  for (std::size_t i = 0; i < VersionCount; ++i) {
+    auto v = QString("%1.%2.%3").arg(number(rng)).arg(number(rng)).arg(number(rng));
+    if (mode == Version::ParseMode::MO2 && i % 4 == 0) {
+      v += QString(".%1").arg(number(rng));
+    }
+
+    versions.push_back(v + suffixes[suffix(rng)]);
+  }
+
+  return versions;
+}
+
+void run(const char* name, Version::ParseMode mode)
+{
+  const auto versions = makeVersions(mode, 42);
+
+  const auto seconds = Bench::measure([&] {
+    for (const auto& v : versions) {
+      Bench::doNotOptimize(Version::parse(v, mode));
+    }
+  });
+
+  Bench::report(name, versions.size(), seconds);
+}
+
+void sort()
+{
+  std::vector<Version> versions;
+  versions.reserve(VersionCount);
+
+  for (const auto& v : makeVersions(Version::ParseMode::MO2, 42)) {
+    versions.push_back(Version::parse(v, Version::ParseMode::MO2));
+  }
+
+  const auto seconds = Bench::measure([&] {
+    std::sort(versions.begin(), versions.end());
+  });
+
+  Bench::report("sort", versions.size(), seconds);
+}
+
+void sortByKey()
+{
+  std::vector<Version> versions;
+  versions.reserve(VersionCount);
+
+  for (const auto& v : makeVersions(Version::ParseMode::MO2, 42)) {
+    versions.push_back(Version::parse(v, Version::ParseMode::MO2));
+  }
+
+  std::vector<std::pair<std::uint64_t, const Version*>> keyed;
+  keyed.reserve(versions.size());
+
+  const auto seconds = Bench::measure([&] {
+    keyed.clear();
+
+    // all the generated versions fit in the key
+    for (const auto& v : versions) {
+      keyed.emplace_back(*v.sortKey(), &v);
+    }
+
+    std::sort(keyed.begin(), keyed.end());
+  });
+
+  Bench::report("sort by key", versions.size(), seconds);
+}
+
+void sortVersionInfo()
+{
+  std::vector<VersionInfo> versions;
+  versions.reserve(VersionCount);
+
+  for (const auto& v : makeVersions(Version::ParseMode::MO2, 42)) {
+    versions.emplace_back(v);
+  }
+
+  // some decimal mark versions, so that most comparisons go through them
+  for (std::size_t i = 0; i < versions.size(); i += 8) {
+    versions[i].parse(QString("f%1.%2").arg(i % 7).arg(i % 100, 2, 10, QChar(u'0')));
+  }
+
+  const auto seconds = Bench::measure([&] {
+    std::sort(versions.begin(), versions.end());
+  });
+
+  Bench::report("sort versioninfo", versions.size(), seconds);
+}
+
+}  // namespace
+
+void benchVersioning()
+{
+  run("parse semver", Version::ParseMode::SemVer);
+  run("parse mo2", Version::ParseMode::MO2);
+  sort();
+  sortByKey();
+  sortVersionInfo();
+}
@@ -28,6 +28,25 @@ TEST(FormatterTest, String)
   ASSERT_EQ("Hello World!", std::format("{}", L"Hello World!"s));
   ASSERT_EQ("Hello World!", std::format("{}", QString("Hello World!")));
   ASSERT_EQ(L"Hello World!", std::format(L"{}", QString("Hello World!")));
+
+  // non-ASCII characters, including a surrogate pair
+  const auto utf8 = std::string("caf\xc3\xa9 \xe4\xb8\xad \xf0\x9f\x98\x80");
+  ASSERT_EQ(utf8, std::format("{}", QString::fromUtf8(utf8)));
+  ASSERT_EQ(utf8, std::format("{}", QStringView(QString::fromUtf8(utf8))));
+  ASSERT_EQ("\xef\xbf\xbd", std::format("{}", QString(QChar(0xd800))));
+
+  // longer than a chunk
+  const QString longString(1000, QChar(0xe9));
+  ASSERT_EQ(longString.toStdString(), std::format("{}", longString));
+
+  // specifications
+  ASSERT_EQ("MO2  ", std::format("{:5}", QString("MO2")));
+  ASSERT_EQ("**MO2", std::format("{:*>5}", QString("MO2")));
+  ASSERT_EQ("Mod", std::format("{:.3}", QString("Mod Organizer")));
+  ASSERT_EQ("\"MO2\"", std::format("{:?}", QString("MO2")));
+  ASSERT_EQ(std::string(1000, 'x') + "!",
+            std::format("{:!<1001}", QString(1000, QChar(u'x'))));
+  ASSERT_EQ(L"  MO2", std::format(L"{:>5}", QStringView(u"MO2")));
 }
 
 TEST(FormatterTest, RandomAccessContainer)
@@ -8,6 +8,7 @@
 #include <string>
 #include <unordered_set>
 #include <variant>
+#include <vector>
 
 #include <uibase/ifiletree.h>
 
@@ -225,6 +226,42 @@ createMapping(std::shared_ptr<const IFileTree> fileTree)
   return mapping;
 }
 
+TEST(IFileTreeTest, FileNameHashAndEqual)
+{
+  const FileNameHash hash;
+  const FileNameEqual equal;
+
+  // long enough for the vectorized paths
+  const QString lower = "textures/armor/daedric/daedricarmor_n.dds";
+  const QString upper = "TEXTURES/Armor/Daedric/DaedricArmor_N.DDS";
+
+  for (auto&& [a, b] : std::vector<std::pair<QString, QString>>{
+           {"", ""},
+           {"a", "A"},
+           {lower, upper},
+           {QString::fromUtf8("Données"), QString::fromUtf8("DONNÉES")},
+           {lower + QString::fromUtf8("é"), upper + QString::fromUtf8("É")},
+           // the Kelvin sign is case-folded to an ASCII letter
+           {QString::fromUtf16(u"\u212a.esp"), "k.esp"}}) {
+    EXPECT_EQ(FileNameComparator::compare(a, b), 0);
+    EXPECT_TRUE(equal(a, b)) << a << " " << b;
+    EXPECT_EQ(hash(a), hash(b)) << a << " " << b;
+  }
+
+  EXPECT_FALSE(equal(lower, upper.chopped(1) + "T"));
+  EXPECT_FALSE(equal(lower, lower.chopped(1)));
+  EXPECT_FALSE(equal("@[", "`{"));
+  EXPECT_NE(hash(lower), hash(lower.chopped(1)));
+
+  FileNameMap<int> map{{"Data", 1}, {"meshes", 2}};
+  EXPECT_EQ(map.at("DATA"), 1);
+  EXPECT_TRUE(map.contains(QStringView(u"MESHES")));
+  EXPECT_FALSE(map.contains(QString("textures")));
+
+  FileNameSet set{"a.esp", "A.ESP", "b.esp"};
+  EXPECT_EQ(set.size(), 2u);
+}
+
 TEST(IFileTreeTest, ExtensionComputedCorrectly)
 {
   // Fake tree to create entry:
@@ -237,6 +274,10 @@ TEST(IFileTreeTest, ExtensionComputedCorrectly)
   fileTree->move(a, "a.c.b");
   EXPECT_EQ(a->name(), "a.c.b");
   EXPECT_EQ(a->suffix(), "b");
+
+  EXPECT_TRUE(a->hasSuffix("B"));
+  EXPECT_TRUE(a->hasSuffix(QStringList{"c", "B"}));
+  EXPECT_FALSE(a->hasSuffix(QStringList{"c", "b.a"}));
 }
 
 TEST(IFileTreeTest, TreeIsPopulatedCorrectly)
@@ -691,6 +732,342 @@ TEST(IFileTreeTest, TreeMoveAndCopyOperations)
   }
 }
 
+TEST(IFileTreeTest, LargeDirectoryOperations)
+{
+  // check that the entries of a large directory are kept sorted (directories first,
+  // then by name) since lookups rely on it
+  const auto isSorted = [](std::shared_ptr<const IFileTree> tree) {
+    return std::is_sorted(tree->begin(), tree->end(), [](auto const& a, auto const& b) {
+      if (a->isDir() != b->isDir()) {
+        return a->isDir();
+      }
+      return FileNameComparator::compare(a->name(), b->name()) < 0;
+    });
+  };
+
+  std::vector<std::pair<QString, bool>> strTree;
+  for (int i = 0; i < 500; ++i) {
+    strTree.push_back({QString("dir%1").arg(i), true});
+  }
+  for (int i = 0; i < 2000; ++i) {
+    strTree.push_back({QString("File%1.txt").arg(i), false});
+  }
+
+  auto fileTree = FileListTree::makeTree(std::move(strTree));
+  EXPECT_EQ(fileTree->size(), std::size_t{2500});
+  EXPECT_TRUE(isSorted(fileTree));
+
+  for (int i = 0; i < 500; ++i) {
+    EXPECT_NE(fileTree->find(QString("DIR%1").arg(i), IFileTree::DIRECTORY), nullptr);
+    EXPECT_EQ(fileTree->find(QString("dir%1").arg(i), IFileTree::FILE), nullptr);
+  }
+  for (int i = 0; i < 2000; ++i) {
+    EXPECT_NE(fileTree->find(QString("file%1.TXT").arg(i), IFileTree::FILE), nullptr);
+  }
+
+  // renaming in-place must move the entry to its new position
+  auto file10 = fileTree->find("file10.txt");
+  EXPECT_TRUE(fileTree->move(file10, "aaa.txt"));
+  EXPECT_TRUE(isSorted(fileTree));
+  EXPECT_EQ(fileTree->find("aaa.txt"), file10);
+  EXPECT_EQ(fileTree->find("file10.txt"), nullptr);
+  EXPECT_EQ(fileTree->at(500), file10);
+  EXPECT_EQ(fileTree->size(), std::size_t{2500});
+
+  auto dir0 = fileTree->find("dir0");
+  EXPECT_TRUE(fileTree->move(dir0, "zzz"));
+  EXPECT_TRUE(isSorted(fileTree));
+  EXPECT_EQ(fileTree->find("zzz"), dir0);
+  EXPECT_EQ(fileTree->at(499), dir0);
+
+  // renaming to an existing name fails and restores the original name and position
+  auto file11 = fileTree->find("file11.txt");
+  EXPECT_FALSE(fileTree->move(file11, "file12.txt"));
+  EXPECT_EQ(file11->name(), "file11.txt");
+  EXPECT_EQ(fileTree->find("file11.txt"), file11);
+  EXPECT_TRUE(isSorted(fileTree));
+
+  // moving entries out of the directory
+  auto dir1 = fileTree->findDirectory("dir1");
+  for (int i = 100; i < 200; ++i) {
+    EXPECT_TRUE(fileTree->move(fileTree->find(QString("file%1.txt").arg(i)), "dir1/"));
+  }
+  EXPECT_EQ(dir1->size(), std::size_t{100});
+  EXPECT_EQ(fileTree->size(), std::size_t{2400});
+  EXPECT_TRUE(isSorted(fileTree));
+  EXPECT_TRUE(isSorted(dir1));
+
+  // erasing entries
+  for (int i = 200; i < 300; ++i) {
+    auto entry = fileTree->find(QString("file%1.txt").arg(i));
+    EXPECT_NE(fileTree->erase(entry), fileTree->end());
+    EXPECT_EQ(entry->parent(), nullptr);
+  }
+  EXPECT_EQ(fileTree->erase("DIR2").second->name(), "dir2");
+  EXPECT_EQ(fileTree->size(), std::size_t{2299});
+  EXPECT_TRUE(isSorted(fileTree));
+
+  // erasing many entries at once, entries of other trees are ignored
+  std::vector<std::shared_ptr<FileTreeEntry>> removed;
+  for (int i = 300; i < 400; ++i) {
+    removed.push_back(fileTree->find(QString("file%1.txt").arg(i)));
+  }
+  removed.push_back(removed.front());
+  removed.push_back(dir1->find("file100.txt"));
+  EXPECT_EQ(fileTree->removeEntries(removed), std::size_t{100});
+  EXPECT_EQ(removed.front()->parent(), nullptr);
+  EXPECT_EQ(removed.back()->parent(), dir1);
+  EXPECT_EQ(fileTree->find("file300.txt"), nullptr);
+  EXPECT_EQ(fileTree->size(), std::size_t{2199});
+  EXPECT_TRUE(isSorted(fileTree));
+}
+
+namespace
+{
+
+// counts the calls to the insert and remove hooks, and vetoes removals
+struct HookCountingTree : public FileListTree
+{
+  int inserts = 0, removes = 0;
+
+  static std::shared_ptr<HookCountingTree> makeTree(std::vector<QString> files)
+  {
+    std::vector<File> pFiles;
+    for (auto& f : files) {
+      pFiles.push_back({QStringList{f}, false});
+    }
+
+    return std::shared_ptr<HookCountingTree>(new HookCountingTree(std::move(pFiles)));
+  }
+
+  bool beforeInsert(IFileTree const*, FileTreeEntry const*) override
+  {
+    ++inserts;
+    return true;
+  }
+
+  bool beforeRemove(IFileTree const*, FileTreeEntry const*) override
+  {
+    ++removes;
+    return false;
+  }
+
+protected:
+  HookCountingTree(std::vector<File>&& files)
+      : FileTreeEntry(nullptr, ""), FileListTree(nullptr, "", std::move(files))
+  {}
+};
+
+}  // namespace
+
+TEST(IFileTreeTest, TreeEditBatchHooks)
+{
+  // renaming in place goes through neither hook, with move() or with a batch
+  auto moved = HookCountingTree::makeTree({"a.txt", "c.txt"});
+  EXPECT_TRUE(moved->move(moved->find("a.txt"), "b.txt"));
+  EXPECT_NE(moved->find("b.txt"), nullptr);
+
+  auto batched = HookCountingTree::makeTree({"a.txt", "c.txt"});
+  TreeEditBatch batch(batched);
+  batch.rename(batched->find("a.txt"), "b.txt");
+  EXPECT_TRUE(batch.apply());
+  EXPECT_NE(batched->find("b.txt"), nullptr);
+
+  EXPECT_EQ(moved->inserts, 0);
+  EXPECT_EQ(moved->removes, 0);
+  EXPECT_EQ(batched->inserts, moved->inserts);
+  EXPECT_EQ(batched->removes, moved->removes);
+}
+
+TEST(IFileTreeTest, TreeEditBatchOperations)
+{
+  // flatten a Data/ wrapper, rename and remove entries in a single batch
+  {
+    auto fileTree = FileListTree::makeTree({{"Data/", true},
+                                            {"Data/meshes/", true},
+                                            {"Data/meshes/a.nif", false},
+                                            {"Data/plugin.esp", false},
+                                            {"readme.txt", false},
+                                            {"old.ini", false}});
+    auto data     = fileTree->findDirectory("Data");
+    auto meshes   = fileTree->find("Data/meshes");
+    auto plugin   = fileTree->find("Data/plugin.esp");
+
+    TreeEditBatch batch(fileTree);
+    batch.move(meshes, "");
+    batch.move(plugin, "");
+    batch.move(fileTree->find("readme.txt"), "docs/readme.md");
+    batch.rename(fileTree->find("old.ini"), "new.ini");
+    batch.remove(data);
+    EXPECT_EQ(batch.size(), std::size_t{5});
+
+    EXPECT_TRUE(batch.apply());
+    EXPECT_TRUE(batch.empty());
+    EXPECT_EQ(data->parent(), nullptr);
+    EXPECT_EQ(fileTree->find("meshes"), meshes);
+    EXPECT_EQ(fileTree->find("plugin.esp"), plugin);
+    EXPECT_EQ(meshes->parent(), fileTree);
+    assertTreeEquals(fileTree, {{"docs", true},
+                                {"docs/readme.md", false},
+                                {"meshes", true},
+                                {"meshes/a.nif", false},
+                                {"plugin.esp", false},
+                                {"new.ini", false}});
+  }
+
+  // entries can swap names within a batch
+  {
+    auto fileTree = FileListTree::makeTree({{"a.txt", false}, {"b.txt", false}});
+    auto a        = fileTree->find("a.txt");
+    auto b        = fileTree->find("b.txt");
+
+    TreeEditBatch batch(fileTree);
+    batch.rename(a, "b.txt");
+    batch.rename(b, "a.txt");
+    EXPECT_TRUE(batch.apply());
+    EXPECT_EQ(fileTree->find("a.txt"), b);
+    EXPECT_EQ(fileTree->find("b.txt"), a);
+  }
+
+  // failing batches leave the tree untouched, including created directories
+  {
+    const std::vector<std::pair<QString, bool>> expected{{"a", true},
+                                                         {"a/x.txt", false},
+                                                         {"b", true},
+                                                         {"b/x.txt", false},
+                                                         {"c.txt", false}};
+    auto fileTree = FileListTree::makeTree(std::vector(expected));
+    auto a        = fileTree->find("a");
+    auto b        = fileTree->find("b");
+
+    // conflict with an existing entry
+    TreeEditBatch batch(fileTree);
+    batch.move(fileTree->find("c.txt"), "new/c.txt");
+    batch.move(fileTree->find("a/x.txt"), "b/");
+    EXPECT_FALSE(batch.apply());
+    EXPECT_TRUE(batch.empty());
+    assertTreeEquals(fileTree, expected);
+
+    // conflict between entries of the batch
+    batch.move(fileTree->find("a/x.txt"), "new/");
+    batch.move(fileTree->find("b/x.txt"), "new/");
+    EXPECT_FALSE(batch.apply());
+    assertTreeEquals(fileTree, expected);
+
+    // directory moved into itself, directly or through another move
+    batch.move(a, "a/sub/");
+    EXPECT_FALSE(batch.apply());
+    batch.move(a, "b/");
+    batch.move(b, "a/");
+    EXPECT_FALSE(batch.apply());
+    assertTreeEquals(fileTree, expected);
+
+    // invalid names, duplicate entries and moves into removed directories
+    batch.rename(fileTree->find("c.txt"), "..");
+    EXPECT_FALSE(batch.apply());
+    batch.remove(a);
+    batch.move(a, "b/");
+    EXPECT_FALSE(batch.apply());
+    batch.remove(a);
+    batch.move(fileTree->find("c.txt"), "a/");
+    EXPECT_FALSE(batch.apply());
+    assertTreeEquals(fileTree, expected);
+  }
+}
+
+TEST(IFileTreeTest, TreePruneOperations)
+{
+  const auto junk = [](auto const& entry) {
+    return entry->compare("Thumbs.db") == 0 || entry->hasSuffix("psd");
+  };
+
+  {
+    auto fileTree = FileListTree::makeTree({{"a/Thumbs.db", false},
+                                            {"a/b/c.psd", false},
+                                            {"a/b/c.dds", false},
+                                            {"a/d/thumbs.db", false},
+                                            {"a/d/e.PSD", false},
+                                            {"empty/", true},
+                                            {"x.psd", false},
+                                            {"y.esp", false}});
+    auto d        = fileTree->find("a/d");
+
+    auto counts = fileTree->pruneRecursive(junk);
+    EXPECT_EQ(counts.files, std::size_t{5});
+    EXPECT_EQ(counts.directories, std::size_t{0});
+    EXPECT_NE(d->parent(), nullptr);
+    assertTreeEquals(fileTree, {{"a", true},
+                                {"a/b", true},
+                                {"a/b/c.dds", false},
+                                {"a/d", true},
+                                {"empty", true},
+                                {"y.esp", false}});
+
+    counts = fileTree->pruneRecursive(junk, true);
+    EXPECT_EQ(counts.files, std::size_t{0});
+    EXPECT_EQ(counts.directories, std::size_t{2});
+    EXPECT_EQ(d->parent(), nullptr);
+    assertTreeEquals(fileTree, {{"a", true},
+                                {"a/b", true},
+                                {"a/b/c.dds", false},
+                                {"y.esp", false}});
+  }
+
+  // directories that become empty are pruned bottom-up in a single call, and matching
+  // directories are not populated
+  {
+    auto fileTree = FileListTree::makeTree(
+        {{"a/b/c/Thumbs.db", false}, {"a/b/d.psd", false}, {"skip/e.txt", false}});
+    auto skip     = fileTree->findDirectory("skip");
+
+    auto counts = fileTree->pruneRecursive(
+        [&junk](auto const& entry) {
+          return entry->compare("skip") == 0 || junk(entry);
+        },
+        true);
+    EXPECT_EQ(counts.files, std::size_t{2});
+    EXPECT_EQ(counts.directories, std::size_t{4});
+    EXPECT_FALSE(populated(skip));
+    EXPECT_TRUE(fileTree->empty());
+  }
+}
+
+TEST(IFileTreeTest, TreeMemoryUsage)
+{
+  auto fileTree =
+      FileListTree::makeTree({{"a/b.txt", false}, {"c.txt", false}, {"d/", true}});
+
+  // computing the memory usage should not populate the tree
+  auto usage = fileTree->memoryUsage();
+  EXPECT_FALSE(populated(fileTree));
+  EXPECT_EQ(usage.files, std::size_t{0});
+  EXPECT_EQ(usage.directories, std::size_t{0});
+  EXPECT_EQ(usage.nodes, sizeof(IFileTree));
+
+  EXPECT_EQ(fileTree->size(), std::size_t{3});
+  usage = fileTree->memoryUsage();
+  EXPECT_FALSE(populated(fileTree->findDirectory("a")));
+  EXPECT_EQ(usage.files, std::size_t{1});
+  EXPECT_EQ(usage.directories, std::size_t{2});
+
+  EXPECT_NE(fileTree->find("a/b.txt"), nullptr);
+  const auto before = usage;
+  usage             = fileTree->memoryUsage();
+  EXPECT_EQ(usage.files, std::size_t{2});
+  EXPECT_EQ(usage.directories, std::size_t{2});
+  EXPECT_EQ(usage.nodes, 3 * sizeof(IFileTree) + 2 * sizeof(FileTreeEntry));
+  EXPECT_GT(usage.names, before.names);
+  EXPECT_GT(usage.children, before.children);
+  EXPECT_GT(usage.controlBlocks, before.controlBlocks);
+  EXPECT_EQ(usage.total(),
+            usage.nodes + usage.names + usage.children + usage.controlBlocks);
+
+  // names are interned, so the same name in different directories is shared
+  auto other = FileListTree::makeTree({{"a/b.txt", false}});
+  EXPECT_EQ(other->find("a/b.txt")->name().constData(),
+            fileTree->find("a/b.txt")->name().constData());
+}
+
 TEST(IFileTreeTest, TreeMergeOperations)
 {
 
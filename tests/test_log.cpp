@@ -0,0 +1,634 @@
+#pragma warning(push)
+#pragma warning(disable : 4668)
+#include <gtest/gtest.h>
+#pragma warning(pop)
+
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <uibase/binarylog.h>
+#include <uibase/log.h>
+
+using namespace MOBase;
+
+namespace
+{
+
+// entries received by the callback of the test loggers
+std::vector<log::Entry> g_entries;
+
+void collect(log::Entry e)
+{
+  g_entries.push_back(std::move(e));
+}
+
+// number of times a Counted value has been formatted
+int g_formatted = 0;
+
+struct Counted
+{};
+
+std::unique_ptr<log::Logger> makeLogger(log::Levels level)
+{
+  g_entries.clear();
+  g_formatted = 0;
+
+  auto logger = std::make_unique<log::Logger>(
+      log::LoggerConfiguration{.name = "test", .maxLevel = level, .pattern = "%v"});
+  logger->setCallback(&collect);
+  return logger;
+}
+
+}  // namespace
+
+template <>
+struct std::formatter<Counted, char> : std::formatter<std::string_view, char>
+{
+  template <class FmtContext>
+  typename FmtContext::iterator format(Counted, FmtContext& ctx) const
+  {
+    ++g_formatted;
+    return std::formatter<std::string_view, char>::format("counted", ctx);
+  }
+};
+
+TEST(LogTest, LevelCheckedBeforeFormatting)
+{
+  auto logger = makeLogger(log::Info);
+
+  EXPECT_FALSE(logger->enabled(log::Debug));
+  EXPECT_TRUE(logger->enabled(log::Info));
+  EXPECT_TRUE(logger->enabled(log::Error));
+
+  logger->debug("debug {}", Counted{});
+  logger->log(log::Debug, std::string("debug {}"), Counted{});
+  EXPECT_EQ(g_formatted, 0);
+  EXPECT_TRUE(g_entries.empty());
+
+  logger->info("info {}", Counted{});
+  EXPECT_EQ(g_formatted, 1);
+  ASSERT_EQ(g_entries.size(), std::size_t{1});
+  EXPECT_EQ(g_entries[0].level, log::Info);
+  EXPECT_EQ(g_entries[0].message, "info counted");
+
+  logger->setLevel(log::Debug);
+  EXPECT_EQ(logger->level(), log::Debug);
+  EXPECT_TRUE(logger->enabled(log::Debug));
+
+  logger->debug("debug {}", Counted{});
+  EXPECT_EQ(g_formatted, 2);
+  ASSERT_EQ(g_entries.size(), std::size_t{2});
+  EXPECT_EQ(g_entries[1].level, log::Debug);
+}
+
+TEST(LogTest, Blacklist)
+{
+  auto logger = makeLogger(log::Info);
+
+  const auto logged = [&logger](std::string const& message) {
+    g_entries.clear();
+    logger->info("{}", message);
+    return g_entries.empty() ? std::string() : g_entries.back().message;
+  };
+
+  EXPECT_EQ(logged("C:/Users/lords/AppData"), "C:/Users/lords/AppData");
+
+  logger->addToBlacklist("/lords", "/USERNAME");
+  logger->addToBlacklist("secret", "***");
+  EXPECT_EQ(logged("C:/Users/Lords/AppData, C:/USERS/LORDS"),
+            "C:/Users/USERNAME/AppData, C:/USERS/USERNAME");
+  EXPECT_EQ(logged("SeCrEt secretsecret secre"), "*** ****** secre");
+
+  // the longest filter wins between filters starting at the same position, and the
+  // leftmost one between overlapping filters
+  logger->addToBlacklist("/lordship", "/TITLE");
+  logger->addToBlacklist("ship", "BOAT");
+  EXPECT_EQ(logged("/lordship /lords ship"), "/TITLE /USERNAME BOAT");
+
+  // replacements are updated in place and are not scanned again
+  logger->addToBlacklist("SECRET", "secret");
+  EXPECT_EQ(logged("a secret"), "a secret");
+
+  logger->removeFromBlacklist("Secret");
+  logger->removeFromBlacklist("ship");
+  EXPECT_EQ(logged("secret ship /lordship"), "secret ship /TITLE");
+
+  logger->resetBlacklist();
+  EXPECT_EQ(logged("/lords"), "/lords");
+}
+
+TEST(LogTest, AsyncLogger)
+{
+  g_entries.clear();
+
+  auto logger = std::make_unique<log::Logger>(
+      log::LoggerConfiguration{
+          .name = "test-async", .maxLevel = log::Debug, .pattern = "%v"},
+      log::LoggerOptions{.async         = true,
+                         .queueSize     = 16,
+                         .threads       = 1,
+                         .overflow      = log::OverflowPolicy::Block,
+                         .flushLevel    = log::Error,
+                         .flushInterval = std::chrono::milliseconds(10)});
+  logger->setCallback(&collect);
+
+  for (int i = 0; i < 100; ++i) {
+    logger->debug("message {}", i);
+  }
+
+  // flushing waits for the queue, in order with a single thread
+  logger->flush();
+
+  ASSERT_EQ(g_entries.size(), std::size_t{100});
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(g_entries[i].message, std::format("message {}", i));
+  }
+
+  // dumped messages are queued with the others
+  logger->setFlightRecorder({.capacity = 8, .dumpOnError = false});
+  logger->setLevel(log::Info);
+  logger->debug("recorded");
+  logger->info("before");
+  logger->dumpFlightRecorder();
+  logger->info("after");
+
+  // destroying the logger writes everything left in the queue
+  logger.reset();
+
+  std::vector<std::string> messages;
+  for (std::size_t i = 100; i < g_entries.size(); ++i) {
+    messages.push_back(g_entries[i].message);
+  }
+
+  EXPECT_EQ(messages, (std::vector<std::string>{
+                          "before", "flight recorder, last 1 messages:", "recorded",
+                          "end of flight recorder", "after"}));
+}
+
+TEST(LogTest, BinaryLogger)
+{
+  auto target = makeLogger(log::Debug);
+  const auto file =
+      std::filesystem::temp_directory_path() / "uibase-test-binarylog.bin";
+
+  const std::string stdString = "std::string";
+  const QString qString       = QString::fromUtf8("QString \u00e9");
+  const void* pointer         = &stdString;
+
+  const auto expected =
+      std::format("{} {:>5} {:.2f} {} {} {} {} {} {:#x} {}", 42, -7, 3.14159, true,
+                  'c', "literal", stdString, qString, 255u, pointer);
+
+  {
+    log::BinaryLogger logger(
+        {.file = file, .target = target.get(), .maxLevel = log::Info});
+
+    // disabled levels are not formatted, even when falling back to formatting
+    logger.debug("{}", Counted{});
+    EXPECT_EQ(g_formatted, 0);
+
+    logger.info("{} {:>5} {:.2f} {} {} {} {} {} {:#x} {}", 42, -7, 3.14159, true,
+                'c', "literal", stdString, qString, 255u, pointer);
+    logger.warn("{}", Counted{});
+    EXPECT_EQ(g_formatted, 1);
+
+    // floats are not widened, and arguments formatted now use the
+    // specification of their replacement field
+    const auto logged = std::chrono::system_clock::now();
+    logger.info("{} {:>9}", 0.1f, Counted{});
+    EXPECT_EQ(g_formatted, 2);
+
+    // formatting is done by the background thread or when flushing, the time
+    // is the one of the call
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    logger.flush();
+    ASSERT_EQ(g_entries.size(), std::size_t{3});
+    EXPECT_EQ(g_entries[0].level, log::Info);
+    EXPECT_EQ(g_entries[0].message, expected);
+    EXPECT_EQ(g_entries[1].level, log::Warning);
+    EXPECT_EQ(g_entries[1].message, "counted");
+    EXPECT_EQ(g_entries[2].message, "0.1   counted");
+    EXPECT_LT(g_entries[2].time, logged + std::chrono::milliseconds(100));
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&logger, t] {
+        for (int i = 0; i < 1000; ++i) {
+          logger.error("thread {} message {}", t, i);
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    EXPECT_EQ(logger.dropped(), std::uint64_t{0});
+  }
+
+  // everything is in the file, in order for each thread
+  std::vector<log::Entry> entries;
+  EXPECT_TRUE(log::decodeBinaryLog(file, [&entries](log::Entry e) {
+    entries.push_back(std::move(e));
+  }));
+
+  ASSERT_EQ(entries.size(), std::size_t{4003});
+  EXPECT_EQ(entries[0].message, expected);
+  EXPECT_EQ(entries[1].message, "counted");
+  EXPECT_EQ(entries[2].message, "0.1   counted");
+
+  std::array<int, 4> next{};
+  for (std::size_t i = 3; i < entries.size(); ++i) {
+    // "thread X message Y"
+    ASSERT_GT(entries[i].message.size(), std::size_t{7});
+    const int t = entries[i].message[7] - '0';
+    ASSERT_TRUE(t >= 0 && t < 4);
+    EXPECT_EQ(entries[i].message, std::format("thread {} message {}", t, next[t]++));
+    EXPECT_EQ(entries[i].level, log::Error);
+  }
+
+  std::filesystem::remove(file);
+}
+
+TEST(LogTest, FlightRecorder)
+{
+  auto logger = makeLogger(log::Info);
+  logger->setFlightRecorder({.capacity = 4});
+
+  const auto messages = [] {
+    std::vector<std::string> v;
+    for (auto& e : g_entries) {
+      v.push_back(e.message);
+    }
+    return v;
+  };
+
+  // recorded but not logged
+  for (int i = 0; i < 6; ++i) {
+    logger->debug("debug {}", i);
+  }
+  EXPECT_TRUE(g_entries.empty());
+
+  std::thread([&logger] {
+    logger->debug("other thread");
+  }).join();
+
+  logger->info("info");
+  logger->error("error");
+
+  // the ring of the main thread only kept the last 4 messages, the info message
+  // is already written and not recorded
+  EXPECT_EQ(messages(),
+            (std::vector<std::string>{"info", "flight recorder, last 5 messages:",
+                                      "debug 2", "debug 3", "debug 4", "debug 5",
+                                      "other thread", "end of flight recorder",
+                                      "error"}));
+  EXPECT_EQ(g_entries[2].level, log::Debug);
+
+  // messages are only dumped once
+  g_entries.clear();
+  logger->error("error");
+  EXPECT_EQ(messages(), std::vector<std::string>{"error"});
+
+  g_entries.clear();
+  logger->debug("on demand");
+  logger->dumpFlightRecorder();
+  EXPECT_EQ(messages(),
+            (std::vector<std::string>{"flight recorder, last 1 messages:", "on demand",
+                                      "end of flight recorder"}));
+
+  // whether a message is written depends on the level when it is logged
+  g_entries.clear();
+  logger->debug("before setLevel");
+  logger->setLevel(log::Debug);
+  logger->dumpFlightRecorder();
+  logger->setLevel(log::Info);
+  EXPECT_EQ(messages(), (std::vector<std::string>{"flight recorder, last 1 messages:",
+                                                  "before setLevel",
+                                                  "end of flight recorder"}));
+
+  // separate file
+  const auto file =
+      std::filesystem::temp_directory_path() / "uibase-test-flightrecorder.log";
+  std::filesystem::remove(file);
+
+  logger->setFlightRecorder({.capacity = 4, .file = file});
+  g_entries.clear();
+  logger->debug("to file");
+  logger->error("error");
+  EXPECT_EQ(messages(), std::vector<std::string>{"error"});
+
+  std::ifstream in(file);
+  std::string header, line;
+  std::getline(in, header);
+  std::getline(in, line);
+  EXPECT_EQ(header, "flight recorder, 1 messages:");
+  EXPECT_TRUE(line.ends_with("[debug] to file"));
+
+  in.close();
+  std::filesystem::remove(file);
+
+  // disabled, debug messages are not formatted anymore
+  logger->setFlightRecorder({});
+  logger->debug("{}", Counted{});
+  EXPECT_EQ(g_formatted, 0);
+}
+
+TEST(LogTest, RateLimitAndDuplicates)
+{
+  g_entries.clear();
+
+  auto limited = std::make_unique<log::Logger>(
+      log::LoggerConfiguration{
+          .name = "test-ratelimit", .maxLevel = log::Debug, .pattern = "%v"},
+      log::LoggerOptions{.rateLimit = 3, .rateInterval = std::chrono::hours(1)});
+  limited->setCallback(&collect);
+
+  for (int i = 0; i < 10; ++i) {
+    limited->warn("failing in a loop {}", i);
+  }
+
+  // other call sites are not affected
+  limited->warn("another call site");
+
+  ASSERT_EQ(g_entries.size(), std::size_t{4});
+  EXPECT_EQ(g_entries[2].message, "failing in a loop 2");
+  EXPECT_EQ(g_entries[3].message, "another call site");
+
+  limited->flush();
+  ASSERT_EQ(g_entries.size(), std::size_t{5});
+  EXPECT_EQ(g_entries[4].message, "7 messages were suppressed by the rate limit");
+
+  g_entries.clear();
+
+  auto coalescing = std::make_unique<log::Logger>(
+      log::LoggerConfiguration{
+          .name = "test-duplicates", .maxLevel = log::Debug, .pattern = "%v"},
+      log::LoggerOptions{.coalesceDuplicates = true});
+  coalescing->setCallback(&collect);
+
+  for (int i = 0; i < 5; ++i) {
+    coalescing->info("same {}", 1);
+  }
+  coalescing->info("same {}", 2);
+  coalescing->warn("same {}", 2);
+  coalescing->warn("same {}", 2);
+  coalescing->flush();
+
+  std::vector<std::string> messages;
+  for (auto& e : g_entries) {
+    messages.push_back(e.message);
+  }
+
+  EXPECT_EQ(messages, (std::vector<std::string>{
+                          "same 1", "last message repeated 4 times", "same 2",
+                          "same 2", "last message repeated 1 times"}));
+  EXPECT_EQ(g_entries[4].level, log::Warning);
+}
+
+TEST(LogTest, MultilineMessages)
+{
+  g_entries.clear();
+
+  auto logger = std::make_unique<log::Logger>(log::LoggerConfiguration{
+      .name = "test-multiline", .maxLevel = log::Debug, .pattern = "%l: %v"});
+  logger->setCallback(&collect);
+
+  // a single message for the sinks, but still one entry per line
+  logger->info("first\nsecond\n\nfourth");
+
+  ASSERT_EQ(g_entries.size(), std::size_t{4});
+  EXPECT_EQ(g_entries[0].message, "first");
+  EXPECT_EQ(g_entries[1].message, "second");
+  EXPECT_EQ(g_entries[2].message, "");
+  EXPECT_EQ(g_entries[3].message, "fourth");
+  EXPECT_EQ(g_entries[1].formattedMessage, "info: second");
+  EXPECT_EQ(g_entries[3].level, log::Info);
+}
+
+TEST(LogTest, ViewAndBatchCallbacks)
+{
+  static std::vector<std::string> views;
+  static std::vector<std::vector<std::string>> batches;
+
+  views.clear();
+  batches.clear();
+
+  auto logger = makeLogger(log::Debug);
+  logger->setCallback(nullptr);
+
+  logger->setViewCallback([](const log::EntryView& e) {
+    views.emplace_back(e.formattedMessage);
+  });
+
+  // never delivered by the background thread during the test
+  logger->setBatchCallback(
+      [](std::span<const log::EntryView> entries) {
+        auto& batch = batches.emplace_back();
+        for (auto& e : entries) {
+          batch.emplace_back(e.message);
+        }
+      },
+      std::chrono::hours(1));
+
+  logger->info("first");
+  logger->warn("second\nthird");
+
+  EXPECT_EQ(views, (std::vector<std::string>{"first", "second", "third"}));
+  EXPECT_TRUE(g_entries.empty());
+  EXPECT_TRUE(batches.empty());
+
+  logger->flush();
+  ASSERT_EQ(batches.size(), std::size_t{1});
+  EXPECT_EQ(batches[0], (std::vector<std::string>{"first", "second", "third"}));
+
+  // nothing new
+  logger->flush();
+  EXPECT_EQ(batches.size(), std::size_t{1});
+
+  // removing the callback delivers what is left
+  logger->debug("last");
+  logger->setBatchCallback(nullptr, {});
+  ASSERT_EQ(batches.size(), std::size_t{2});
+  EXPECT_EQ(batches[1], std::vector<std::string>{"last"});
+}
+
+TEST(LogTest, Categories)
+{
+  log::createDefault(log::LoggerConfiguration{
+      .name = "test-default", .maxLevel = log::Info, .pattern = "%v"});
+  log::getDefault().setCallback(&collect);
+  g_entries.clear();
+
+  auto& filetree = log::category("filetree");
+  EXPECT_EQ(&filetree, &log::category("filetree"));
+  EXPECT_FALSE(filetree.level().has_value());
+
+  // follows the default logger
+  filetree.debug("hidden");
+  filetree.info("shown {}", 1);
+
+  log::setCategoryLevel("FILE*", log::Debug);
+  EXPECT_EQ(filetree.level(), log::Debug);
+
+  filetree.debug("details {}", 2);
+  log::category("network").debug("hidden");
+  log::debug("hidden");
+
+  // created after the rule
+  log::category("filesystem").debug("also shown");
+
+  log::setCategoryLevel("*", std::nullopt);
+  filetree.debug("hidden");
+
+  std::vector<std::string> messages;
+  for (auto& e : g_entries) {
+    messages.push_back(e.message);
+  }
+
+  EXPECT_EQ(messages,
+            (std::vector<std::string>{"[filetree] shown 1", "[filetree] details 2",
+                                      "[filesystem] also shown"}));
+}
+
+TEST(LogTest, LazyArguments)
+{
+  auto logger = makeLogger(log::Info);
+  int evaluated = 0;
+
+  const auto expensive = [&evaluated] {
+    ++evaluated;
+    return std::string("expensive");
+  };
+
+  // disabled, the arguments are never evaluated
+  MO_LOG_TO(*logger, log::Debug, "{} {}", expensive(), Counted{});
+  log::lazy<log::Debug>(*logger, expensive);
+  EXPECT_EQ(evaluated, 0);
+  EXPECT_EQ(g_formatted, 0);
+  EXPECT_TRUE(g_entries.empty());
+
+  MO_LOG_TO(*logger, log::Info, "{} {}", expensive(), Counted{});
+  log::lazy<log::Warning>(*logger, expensive);
+  EXPECT_EQ(evaluated, 2);
+
+  ASSERT_EQ(g_entries.size(), std::size_t{2});
+  EXPECT_EQ(g_entries[0].message, "expensive counted");
+  EXPECT_EQ(g_entries[1].message, "expensive");
+  EXPECT_EQ(g_entries[1].level, log::Warning);
+
+  static_assert(log::compiledIn(log::Error));
+}
+
+TEST(LogTest, LazyCallSites)
+{
+  g_entries.clear();
+
+  auto logger = std::make_unique<log::Logger>(
+      log::LoggerConfiguration{
+          .name = "test-lazysites", .maxLevel = log::Debug, .pattern = "%v"},
+      log::LoggerOptions{.rateLimit = 3, .rateInterval = std::chrono::hours(1)});
+  logger->setCallback(&collect);
+
+  for (int i = 0; i < 10; ++i) {
+    log::lazy<log::Info>(*logger, [i] {
+      return std::format("first site {}", i);
+    });
+  }
+
+  // a different lazy() call, not limited by the first one
+  for (int i = 0; i < 2; ++i) {
+    log::lazy<log::Info>(*logger, [i] {
+      return std::format("second site {}", i);
+    });
+  }
+
+  // neither are messages with a "{}" format string
+  logger->info("{}", "plain");
+
+  std::vector<std::string> messages;
+  for (auto& e : g_entries) {
+    messages.push_back(e.message);
+  }
+
+  EXPECT_EQ(messages, (std::vector<std::string>{"first site 0", "first site 1",
+                                                "first site 2", "second site 0",
+                                                "second site 1", "plain"}));
+
+  logger->flush();
+  ASSERT_EQ(g_entries.size(), std::size_t{7});
+  EXPECT_EQ(g_entries[6].message, "7 messages were suppressed by the rate limit");
+}
+
+TEST(LogTest, CompressedRotatedFiles)
+{
+  namespace fs = std::filesystem;
+
+  const auto dir = fs::temp_directory_path() / "uibase-test-logcompression";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+
+  auto logger = makeLogger(log::Debug);
+  logger->setCompressedFile(log::File::rotating(dir / "test.log", 200, 2));
+
+  for (int i = 0; i < 20; ++i) {
+    logger->info("a message long enough to rotate the file quickly, {}", i);
+  }
+  logger->flush();
+
+  // everything but the current file is eventually compressed
+  const auto done = [&] {
+    std::size_t compressed = 0;
+
+    for (const auto& e : fs::directory_iterator(dir)) {
+      if (e.path().extension() == ".gz") {
+        ++compressed;
+      } else if (e.path().filename() != "test.log") {
+        return false;
+      }
+    }
+
+    return compressed > 0;
+  };
+
+  for (int i = 0; i < 100 && !done(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+
+  ASSERT_TRUE(done());
+
+  // at most maxFiles compressed files are kept
+  const auto compressed = [&] {
+    std::size_t n = 0;
+    for (const auto& e : fs::directory_iterator(dir)) {
+      n += (e.path().extension() == ".gz");
+    }
+    return n;
+  };
+
+  for (int i = 0; i < 100 && compressed() > 2; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+
+  EXPECT_LE(compressed(), std::size_t{2});
+
+  for (const auto& e : fs::directory_iterator(dir)) {
+    if (e.path().extension() == ".gz") {
+      std::ifstream in(e.path(), std::ios::binary);
+      std::array<char, 2> magic{};
+      in.read(magic.data(), 2);
+
+      EXPECT_EQ(magic[0], '\x1f');
+      EXPECT_EQ(magic[1], '\x8b');
+    }
+  }
+
+  logger.reset();
+  fs::remove_all(dir);
+}
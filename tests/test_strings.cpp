@@ -5,15 +5,34 @@
 
 #include <QCoreApplication>
 
+#include <uibase/ifiletree.h>
+#include <uibase/stringpool.h>
 #include <uibase/strings.h>
+#include <uibase/utility.h>
 
 #include <format>
+#include <thread>
+#include <vector>
 
 using namespace MOBase;
 
 TEST(StringsTest, IEquals)
 {
   ASSERT_TRUE(iequals("hello world", "HelLO WOrlD"));
+
+  // long enough for the vectorized paths, with a difference in the tail
+  const std::string lower = "c:/users/user/appdata/local/modorganizer/starfield/logs";
+  const std::string upper = "C:/USERS/USER/APPDATA/LOCAL/MODORGANIZER/STARFIELD/LOGS";
+  ASSERT_TRUE(iequals(lower, upper));
+  ASSERT_FALSE(iequals(lower, upper.substr(0, upper.size() - 1) + "T"));
+  ASSERT_FALSE(iequals(lower, upper.substr(1)));
+
+  // characters around the letters must not be folded
+  ASSERT_FALSE(iequals("@[`{", "`{@["));
+
+  // bytes outside of ascii go through the locale
+  ASSERT_TRUE(iequals("caf\xe9 " + lower, "CAF\xe9 " + upper));
+  ASSERT_FALSE(iequals("caf\xe9", "caf\xe8"));
 }
 
 TEST(StringsTest, IReplaceAll)
@@ -37,6 +56,77 @@ TEST(StringsTest, IReplaceAll)
       "data path: C:/Users/USERNAME/AppData/Local/ModOrganizer/Starfield",
       ireplace_all("data path: C:/Users/lords/AppData/Local/ModOrganizer/Starfield",
                    "/lords", "/USERNAME"));
+
+  ASSERT_EQ("abc", ireplace_all("abc", "", "x"));
+  ASSERT_EQ("xx", ireplace_all("aaaa", "AA", "x"));
+  ASSERT_EQ("aaaa", ireplace_all("aAaA", "a", "a"));
+  ASSERT_EQ("caf\xe9 MO2 caf\xe9 MO2",
+            ireplace_all("caf\xe9 world caf\xe9 WORLD", "World", "MO2"));
+  ASSERT_EQ("\xe9x\xe9 x\xe9", ireplace_all("\xe9" "ab\xe9 AB\xe9", "aB", "x"));
+  ASSERT_EQ("xx", ireplace_all("\xe9\xe9\xe9\xe9", "\xe9\xe9", "x"));
+}
+
+TEST(StringsTest, InternedStrings)
+{
+  const auto size = internedStringCount();
+
+  {
+    const QString a = internString(u"textures"), b = internString(QString("textures")),
+                  c = internString(u"Textures");
+
+    EXPECT_EQ(a, b);
+    EXPECT_EQ(a.constData(), b.constData());
+    EXPECT_NE(a.constData(), c.constData());
+    EXPECT_EQ(internedStringCount(), size + 2);
+
+    // the pool keeps the hash of the interned strings, not of equal copies
+    EXPECT_EQ(internedFileNameHash(a), FileNameHash{}(u"TEXTURES"));
+    EXPECT_EQ(FileNameHash{}(a), FileNameHash{}(c));
+    EXPECT_FALSE(internedFileNameHash(QString("textures")).has_value());
+    EXPECT_FALSE(internedFileNameHash(QStringView(a).left(3)).has_value());
+
+    EXPECT_TRUE(internString(u"").isEmpty());
+    EXPECT_EQ(internedStringCount(), size + 2);
+  }
+
+  // strings only used by the pool are removed
+  EXPECT_EQ(internedStringCount(), size);
+}
+
+TEST(StringsTest, NaturalSort)
+{
+  EXPECT_LT(naturalCompare("mod 2", "Mod 10"), 0);
+  EXPECT_GT(naturalCompare("mod 10", "mod 2"), 0);
+  EXPECT_LT(naturalSortKey("mod 2").compare(naturalSortKey("Mod 10")), 0);
+
+  QStringList names{"mod 10", "Mod 2", "a", "mod 1", "B"};
+  naturalSort(names);
+  EXPECT_EQ(names, (QStringList{"a", "B", "mod 1", "Mod 2", "mod 10"}));
+
+  // by projection, equal keys keep their order
+  std::vector<std::pair<QString, int>> mods{
+      {"x10", 0}, {"x9", 1}, {"X9", 2}, {"x1", 3}};
+  naturalSort(mods, &std::pair<QString, int>::first);
+
+  std::vector<int> order;
+  for (auto&& m : mods) {
+    order.push_back(m.second);
+  }
+  EXPECT_EQ(order, (std::vector<int>{3, 1, 2, 0}));
+
+  // collators are per thread
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([] {
+      for (int i = 0; i < 1000; ++i) {
+        EXPECT_LT(naturalCompare("file9", "file10"), 0);
+      }
+    });
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
 }
 
 // this is more a tests of the tests
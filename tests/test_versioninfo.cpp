@@ -0,0 +1,50 @@
+#pragma warning(push)
+#pragma warning(disable : 4668)
+#include <gtest/gtest.h>
+#pragma warning(pop)
+
+#include <uibase/versioninfo.h>
+
+using namespace MOBase;
+
+TEST(VersionInfoTest, Compare)
+{
+  // shortcut
+  using v = VersionInfo;
+
+  // regular
+  ASSERT_TRUE(v("1.0.0") < v("1.0.1"));
+  ASSERT_TRUE(v("1.2") < v("1.10"));
+  ASSERT_TRUE(v("1.0.0.1") > v("1.0.0"));
+  ASSERT_TRUE(v(1, 2, 3) == v("1.2.3"));
+  ASSERT_TRUE(v(1, 2, 3, VersionInfo::RELEASE_BETA) < v(1, 2, 3));
+
+  // release types and numeric rest
+  ASSERT_TRUE(v("1.0.0rc1") < v("1.0.0"));
+  ASSERT_TRUE(v("1.0.0alpha") < v("1.0.0beta"));
+  ASSERT_TRUE(v("1.0.0beta2") < v("1.0.0beta10"));
+  ASSERT_TRUE(v("1.0.0 x") < v("1.0.0 y"));
+
+  // decimal mark, used as soon as one of the versions has it
+  ASSERT_TRUE(v("1.05") < v("1.5"));
+  ASSERT_TRUE(v("1.05") < v("1.10"));
+  ASSERT_TRUE(v("1.15") < v("f1.2"));
+  ASSERT_TRUE(v("1.5") == v("f1.50"));
+  ASSERT_TRUE(v("1.5") <= v("f1.50"));
+  ASSERT_TRUE(v("1.5") >= v("f1.50"));
+  ASSERT_FALSE(v("1.5") != v("f1.50"));
+  ASSERT_TRUE(v("f2.0001") > v("f2.0"));
+
+  // dates are lower than everything else, invalid versions are the lowest
+  ASSERT_TRUE(v("d2020.1.1") < v("0.1"));
+  ASSERT_TRUE(v("d2020.1.1") < v("d2020.1.2"));
+  ASSERT_TRUE(v() < v("d2020.1.1"));
+  ASSERT_TRUE(v() == v());
+
+  // the ordering follows the version when it is parsed again or cleared
+  v version("f1.05");
+  version.parse("2.0");
+  ASSERT_TRUE(version > v("1.5"));
+  version.clear();
+  ASSERT_TRUE(version < v("0.0.1"));
+}
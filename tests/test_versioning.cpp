@@ -3,7 +3,11 @@
 #include <gtest/gtest.h>
 #pragma warning(pop)
 
+#include <QRegularExpression>
 #include <QString>
+#include <map>
+#include <optional>
+#include <random>
 #include <vector>
 
 #include <uibase/versioning.h>
@@ -87,4 +91,125 @@ TEST(VersioningTest, VersionCompare)
   ASSERT_TRUE(v(2, 4, 1, ReleaseCandidate, 1) <
               v(2, 4, 1, 0, {ReleaseCandidate, 1, 1}));
   ASSERT_TRUE(v(1, 0, 0) < v(2, 0, 0, Alpha));
+
+  // large numbers and long pre-releases, which do not fit in the sort key
+  ASSERT_TRUE(v(1, 0, 0, ReleaseCandidate, 511) < v(1, 0, 0, ReleaseCandidate, 512));
+  ASSERT_TRUE(v(1, 0, 0, ReleaseCandidate, 512) < v(1, 0, 0));
+  ASSERT_TRUE(v(4095, 0, 0) < v(4096, 0, 0, Alpha));
+  ASSERT_TRUE(v(4096, 0, 0, Alpha) < v(4096, 0, 0));
+  ASSERT_TRUE(v(1, 0, 0, 255) < v(1, 0, 0, 256));
+  ASSERT_TRUE(v(1, 0, 0, 256) < v(1, 0, 1));
+  ASSERT_TRUE(v(2024, 1, 15) < v(20240115, 0, 0));
+  ASSERT_TRUE(v(1, 0, 0, 0, {1, Alpha}) < v(1, 0, 0, Development));
+  ASSERT_TRUE(v(1, 0, 0, 0, {ReleaseCandidate, 1, 0, 2}) <
+              v(1, 0, 0, 0, {ReleaseCandidate, 1, 255}));
+  ASSERT_TRUE(v(1, 0, 0, 0, {ReleaseCandidate, 1, 0, 0}) ==
+              v(1, 0, 0, ReleaseCandidate, 1));
+  ASSERT_TRUE(v(1, 0, 0, 0, {ReleaseCandidate, 0, 0}) == v(1, 0, 0, ReleaseCandidate));
+
+  // sort keys are ordered like the versions
+  ASSERT_FALSE(v(4096, 0, 0).sortKey());
+  ASSERT_FALSE(v(1, 0, 0, ReleaseCandidate, 512).sortKey());
+  ASSERT_FALSE(v(1, 0, 0, 0, {1, Alpha}).sortKey());
+  ASSERT_LT(*v(1, 0, 0, Beta, 11).sortKey(), *v(1, 0, 0, ReleaseCandidate, 1).sortKey());
+  ASSERT_LT(*v(1, 0, 0, ReleaseCandidate, 511).sortKey(), *v(1, 0, 0).sortKey());
+  ASSERT_LT(*v(1, 0, 0, 255).sortKey(), *v(1, 0, 1, Development).sortKey());
+  ASSERT_EQ(*v(2, 4, 1, 0, {ReleaseCandidate, 1, 0}).sortKey(),
+            *v(2, 4, 1, ReleaseCandidate, 1).sortKey());
+}
+
+namespace
+{
+
+// the regular expressions Version::parse() used to be implemented with, the parser
+// must accept and reject the same strings and convert them the same way
+//
+std::optional<Version> parseWithRegex(QString const& value, ParseMode mode)
+{
+  static const QRegularExpression semVer{
+      R"(^(?P<major>0|[1-9]\d*)\.(?P<minor>0|[1-9]\d*)\.(?P<patch>0|[1-9]\d*)(?:-(?P<prerelease>(?:0|[1-9]\d*|\d*[a-zA-Z-][0-9a-zA-Z-]*)(?:\.(?:0|[1-9]\d*|\d*[a-zA-Z-][0-9a-zA-Z-]*))*))?(?:\+(?P<buildmetadata>[0-9a-zA-Z-]+(?:\.[0-9a-zA-Z-]+)*))?$)"};
+  static const QRegularExpression mo2{
+      R"(^v?(?P<major>0|[1-9]\d*)\.(?P<minor>0|[1-9]\d*)\.(?P<patch>0|[1-9]\d*)(?:\.(?P<subpatch>0|[1-9]\d*))?(?:(?P<type>dev|a|alpha|b|beta|rc)(?P<prerelease>0|[1-9](?:[.0-9])*))?(?:\+(?P<buildmetadata>[0-9a-zA-Z-]+(?:\.[0-9a-zA-Z-]+)*))?$)"};
+  static const std::map<QString, Version::ReleaseType> types{
+      {"dev", Development}, {"alpha", Alpha}, {"a", Alpha},
+      {"beta", Beta},       {"b", Beta},      {"rc", ReleaseCandidate}};
+
+  const auto match = (mode == ParseMode::SemVer ? semVer : mo2).match(value);
+  if (!match.hasMatch()) {
+    return {};
+  }
+
+  std::vector<std::variant<int, Version::ReleaseType>> prereleases;
+
+  if (mode == ParseMode::SemVer) {
+    for (auto& part : match.captured("prerelease").split(".", Qt::SkipEmptyParts)) {
+      bool ok             = true;
+      const auto intValue = part.toInt(&ok);
+      if (ok) {
+        prereleases.push_back(intValue);
+        continue;
+      }
+
+      const auto it = types.find(part.toLower());
+      if (it == types.end()) {
+        return {};
+      }
+
+      prereleases.push_back(it->second);
+    }
+  } else if (match.hasCaptured("type")) {
+    prereleases.push_back(types.at(match.captured("type")));
+    for (const auto& part : match.captured("prerelease").split(".", Qt::SkipEmptyParts)) {
+      prereleases.push_back(part.toInt());
+    }
+  }
+
+  return Version(match.captured("major").toInt(), match.captured("minor").toInt(),
+                 match.captured("patch").toInt(), match.captured("subpatch").toInt(),
+                 prereleases, match.captured("buildmetadata").trimmed());
+}
+
+}  // namespace
+
+TEST(VersioningTest, VersionParseMatchesRegex)
+{
+  // strings made of version-like tokens, most of them starting with a valid version
+  const QStringList tokens{"0",     "1",     "2",          "9",         "10",   "01",
+                           "00",    ".",     ".",          "-",         "-1",   "-0",
+                           "+",     "v",     "V",          "a",         "b",    "rc",
+                           "RC",    "alpha", "Alpha",      "beta",      "dev",  "dev1",
+                           "a1",    "x",     "\n",         " ",         "\u00e9",
+                           "99999999999",    "2147483647", "2147483648"};
+  const QStringList bases{"1.2.3",  "0.0.0",  "10.20.30", "1.2.3.4",
+                          "v1.2.3", "01.2.3", "1.2",      ""};
+
+  std::mt19937 random(42);
+  const auto pick = [&random](const QStringList& list) {
+    return list[std::uniform_int_distribution<qsizetype>(0, list.size() - 1)(random)];
+  };
+
+  for (int i = 0; i < 20000; ++i) {
+    QString value = pick(bases);
+    for (int j = std::uniform_int_distribution<int>(0, 6)(random); j > 0; --j) {
+      value += pick(tokens);
+    }
+
+    for (const auto mode : {ParseMode::SemVer, ParseMode::MO2}) {
+      const auto expected = parseWithRegex(value, mode);
+
+      std::optional<Version> actual;
+      try {
+        actual = Version::parse(value, mode);
+      } catch (const InvalidVersionException&) {
+        // rejected
+      }
+
+      ASSERT_EQ(expected.has_value(), actual.has_value()) << value.toStdString();
+      if (expected) {
+        ASSERT_EQ(expected->string(), actual->string()) << value.toStdString();
+        ASSERT_EQ(expected->subpatch(), actual->subpatch());
+        ASSERT_EQ(expected->preReleases(), actual->preReleases());
+      }
+    }
+  }
 }
@@ -0,0 +1,29 @@
+#include <cstdio>
+#include <filesystem>
+
+#include <uibase/binarylog.h>
+
+// prints the messages of a binary log written by MOBase::log::BinaryLogger,
+// one per line
+//
+int wmain(int argc, wchar_t** argv)
+{
+  if (argc != 2) {
+    std::fprintf(stderr, "usage: uibase-logdecode <binary log>\n");
+    return 1;
+  }
+
+  const std::filesystem::path file(argv[1]);
+
+  const bool ok = MOBase::log::decodeBinaryLog(file, [](MOBase::log::Entry e) {
+    std::fwrite(e.formattedMessage.data(), 1, e.formattedMessage.size(), stdout);
+    std::fputc('\n', stdout);
+  });
+
+  if (!ok) {
+    std::fprintf(stderr, "%s is not a binary log\n", file.string().c_str());
+    return 1;
+  }
+
+  return 0;
+}